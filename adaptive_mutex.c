@@ -0,0 +1,231 @@
+/*!
+ * @file
+ * Readers and Writers - adaptive mutex
+ *
+ * Implementation of adaptive mutex. Spinning thread tries to lock mutex (pthread_mutex_trylock) and pauses between
+ * tries - pause doubles after every failed try (up to ADAPTIVE_MUTEX_MAX_BACKOFF). After spin_limit tries thread parks
+ * (pthread_mutex_lock). Successful spin moves spin_limit towards twice the number of tries it needed, every park
+ * lowers spin_limit by one eighth, so spinning is cut down on its own when it does not pay off.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+
+#include "adaptive_mutex.h"
+
+/*!
+ * @brief Minimum spin limit.
+ */
+#define ADAPTIVE_MUTEX_MIN_SPINS 8
+/*!
+ * @brief Maximum spin limit.
+ */
+#define ADAPTIVE_MUTEX_MAX_SPINS 1000
+/*!
+ * @brief Maximum number of pauses between two tries.
+ */
+#define ADAPTIVE_MUTEX_MAX_BACKOFF 64
+/*!
+ * @brief Number of pauses after which thread waiting in MCS queue starts to yield processor.
+ */
+#define ADAPTIVE_MUTEX_YIELD_SPINS 100
+
+/*!
+ * @brief MCS queue node of current thread (thread waits in at most one queue at a time).
+ */
+static _Thread_local struct mcs_node mcs_node;
+
+/*!
+ * @brief Function pauses processor for a moment.
+ */
+static void pause_processor() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*!
+ * @brief Thread puts its node at the end of MCS queue and waits till it is first in queue (spinning on its own node,
+ * after ADAPTIVE_MUTEX_YIELD_SPINS pauses it yields processor).
+ *
+ * @param mutex Mutex
+ * @param node Node of current thread
+ */
+static void mcs_enter(struct adaptive_mutex *mutex, struct mcs_node *node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&node->waiting, 1, memory_order_relaxed);
+    struct mcs_node *previous = atomic_exchange_explicit(&mutex->tail, node, memory_order_acq_rel);
+    if (!previous) {
+        return;
+    }
+    atomic_store_explicit(&previous->next, node, memory_order_release);
+    unsigned int spins = 0;
+    while (atomic_load_explicit(&node->waiting, memory_order_acquire)) {
+        if (++spins > ADAPTIVE_MUTEX_YIELD_SPINS) {
+            sched_yield();
+        } else {
+            pause_processor();
+        }
+    }
+}
+
+/*!
+ * @brief Thread takes its node off MCS queue and lets next thread be first.
+ *
+ * @param mutex Mutex
+ * @param node Node of current thread
+ */
+static void mcs_leave(struct adaptive_mutex *mutex, struct mcs_node *node) {
+    struct mcs_node *next = atomic_load_explicit(&node->next, memory_order_acquire);
+    if (!next) {
+        struct mcs_node *expected = node;
+        if (atomic_compare_exchange_strong_explicit(&mutex->tail, &expected, NULL, memory_order_acq_rel,
+                                                    memory_order_relaxed)) {
+            return;
+        }
+        while (!(next = atomic_load_explicit(&node->next, memory_order_acquire))) {
+            pause_processor();
+        }
+    }
+    atomic_store_explicit(&next->waiting, 0, memory_order_release);
+}
+
+/*!
+ * @brief Thread spins trying to lock mutex with exponential backoff and adapts spin limit.
+ *
+ * @param mutex Mutex
+ * @return 1 if mutex was locked, 0 if spin limit was reached
+ */
+static int spin(struct adaptive_mutex *mutex) {
+    int limit = atomic_load_explicit(&mutex->spin_limit, memory_order_relaxed);
+    int backoff = 1;
+    for (int tries = 1;tries <= limit;tries++) {
+        for (int i = 0;i < backoff;i++) {
+            pause_processor();
+        }
+        if (pthread_mutex_trylock(&mutex->mutex) == 0) {
+            int target = 2 * tries + ADAPTIVE_MUTEX_MIN_SPINS;
+            if (target > ADAPTIVE_MUTEX_MAX_SPINS) {
+                target = ADAPTIVE_MUTEX_MAX_SPINS;
+            }
+            limit += (target - limit) / 8;
+            atomic_store_explicit(&mutex->spin_limit, limit, memory_order_relaxed);
+            return 1;
+        }
+        if (backoff < ADAPTIVE_MUTEX_MAX_BACKOFF) {
+            backoff *= 2;
+        }
+    }
+    limit -= limit / 8;
+    atomic_store_explicit(&mutex->spin_limit, limit < ADAPTIVE_MUTEX_MIN_SPINS ? ADAPTIVE_MUTEX_MIN_SPINS : limit,
+                          memory_order_relaxed);
+    return 0;
+}
+
+/*!
+ * @brief Initialises mutex.
+ *
+ * @param mutex Mutex
+ * @param mode Mode (ADAPTIVE_MUTEX_PTHREAD / ADAPTIVE_MUTEX_SPIN / ADAPTIVE_MUTEX_MCS)
+ */
+void adaptive_mutex_init(struct adaptive_mutex *mutex, int mode) {
+    pthread_mutex_init(&mutex->mutex, NULL);
+    mutex->mode = mode;
+    atomic_init(&mutex->spin_limit, ADAPTIVE_MUTEX_MAX_SPINS / 10);
+    atomic_init(&mutex->tail, NULL);
+    atomic_init(&mutex->fast_count, 0);
+    atomic_init(&mutex->spin_count, 0);
+    atomic_init(&mutex->park_count, 0);
+}
+
+/*!
+ * @brief Destroys mutex.
+ *
+ * @param mutex Mutex
+ */
+void adaptive_mutex_destroy(struct adaptive_mutex *mutex) {
+    pthread_mutex_destroy(&mutex->mutex);
+}
+
+/*!
+ * @brief Locks mutex. If first try fails, thread spins (in MCS mode - first waits for its turn in MCS queue) and then
+ * parks. Every lock is counted as fast, spin or park.
+ *
+ * @param mutex Mutex
+ */
+void adaptive_mutex_lock(struct adaptive_mutex *mutex) {
+    if (mutex->mode == ADAPTIVE_MUTEX_PTHREAD) {
+        pthread_mutex_lock(&mutex->mutex);
+        return;
+    }
+    if (pthread_mutex_trylock(&mutex->mutex) == 0) {
+        atomic_fetch_add_explicit(&mutex->fast_count, 1, memory_order_relaxed);
+        return;
+    }
+    int locked;
+    if (mutex->mode == ADAPTIVE_MUTEX_MCS) {
+        mcs_enter(mutex, &mcs_node);
+        locked = spin(mutex);
+        mcs_leave(mutex, &mcs_node);
+    } else {
+        locked = spin(mutex);
+    }
+    if (locked) {
+        atomic_fetch_add_explicit(&mutex->spin_count, 1, memory_order_relaxed);
+        return;
+    }
+    pthread_mutex_lock(&mutex->mutex);
+    atomic_fetch_add_explicit(&mutex->park_count, 1, memory_order_relaxed);
+}
+
+/*!
+ * @brief Unlocks mutex.
+ *
+ * @param mutex Mutex
+ */
+void adaptive_mutex_unlock(struct adaptive_mutex *mutex) {
+    pthread_mutex_unlock(&mutex->mutex);
+}
+
+/*!
+ * @brief Prints numbers (and percents) of locks that got mutex at first try, while spinning and after parking, and
+ * current spin limit. In ADAPTIVE_MUTEX_PTHREAD mode nothing is counted, so nothing is printed.
+ *
+ * @param mutex Mutex
+ */
+void adaptive_mutex_print_stats(struct adaptive_mutex *mutex) {
+    if (mutex->mode == ADAPTIVE_MUTEX_PTHREAD) {
+        return;
+    }
+    long long fast = atomic_load(&mutex->fast_count);
+    long long spin = atomic_load(&mutex->spin_count);
+    long long park = atomic_load(&mutex->park_count);
+    double total = fast + spin + park > 0 ? (double) (fast + spin + park) : 1.0;
+    printf("%-24s %10s %12s\n", "Mutex locks", "count", "percent");
+    printf("%-24s %10lld %12.2f\n", "Fast", fast, 100.0 * fast / total);
+    printf("%-24s %10lld %12.2f\n", "Spin", spin, 100.0 * spin / total);
+    printf("%-24s %10lld %12.2f\n", "Park", park, 100.0 * park / total);
+    printf("%-24s %10i\n\n", "Spin limit", atomic_load(&mutex->spin_limit));
+}
+
+/*!
+ * @brief Function gets mode by its name.
+ *
+ * @param name Mode name (pthread / adaptive / mcs)
+ * @return Mode (ADAPTIVE_MUTEX_PTHREAD / ADAPTIVE_MUTEX_SPIN / ADAPTIVE_MUTEX_MCS) or -1 if name is unknown
+ */
+int adaptive_mutex_mode(const char *name) {
+    if (strcmp(name, "pthread") == 0) {
+        return ADAPTIVE_MUTEX_PTHREAD;
+    } else if (strcmp(name, "adaptive") == 0) {
+        return ADAPTIVE_MUTEX_SPIN;
+    } else if (strcmp(name, "mcs") == 0) {
+        return ADAPTIVE_MUTEX_MCS;
+    }
+    return -1;
+}
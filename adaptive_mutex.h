@@ -0,0 +1,96 @@
+/*!
+ * @file
+ * Readers and Writers - adaptive mutex
+ *
+ * Library mutex that spins for a while before it parks thread in kernel. Critical sections of library are only a few
+ * stores, so thread that finds mutex locked usually gets it after a short spin, without futex syscalls and context
+ * switches. Mutex wraps pthread_mutex_t, so conditional variables can still wait on it. Modes:
+ * - ADAPTIVE_MUTEX_PTHREAD - plain pthread_mutex_t (no spinning, no counters),
+ * - ADAPTIVE_MUTEX_SPIN - bounded spin with exponential backoff, then park. Spin limit adapts to how long successful
+ * spins take and it shrinks when spinning fails (for example when there are more threads than cores),
+ * - ADAPTIVE_MUTEX_MCS - like ADAPTIVE_MUTEX_SPIN, but spinning threads wait in MCS queue (every thread spins on its
+ * own node) and only the first one spins on mutex, so contended mutex cache line is not hammered by all spinners.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef ADAPTIVE_MUTEX_H
+#define ADAPTIVE_MUTEX_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+/*!
+ * @brief Plain pthread_mutex_t.
+ */
+#define ADAPTIVE_MUTEX_PTHREAD 0
+/*!
+ * @brief Spin then park.
+ */
+#define ADAPTIVE_MUTEX_SPIN 1
+/*!
+ * @brief Spin in MCS queue then park.
+ */
+#define ADAPTIVE_MUTEX_MCS 2
+
+/*!
+ * @brief Cache line size - mutex, MCS queue tail and counters are kept in different lines.
+ */
+#define ADAPTIVE_MUTEX_CACHE_LINE 64
+
+/*!
+ * @brief Node of MCS queue of spinning threads. Every thread has its own node.
+ */
+struct mcs_node {
+/*!
+ * @brief next thread in queue
+ */
+    _Alignas(ADAPTIVE_MUTEX_CACHE_LINE) _Atomic(struct mcs_node *) next;
+/*!
+ * @brief flag reset by previous thread when this thread becomes first in queue
+ */
+    atomic_int waiting;
+};
+
+/*!
+ * @brief Adaptive mutex.
+ */
+struct adaptive_mutex {
+/*!
+ * @brief mutex (conditional variables wait on it)
+ */
+    _Alignas(ADAPTIVE_MUTEX_CACHE_LINE) pthread_mutex_t mutex;
+/*!
+ * @brief mode (ADAPTIVE_MUTEX_PTHREAD / ADAPTIVE_MUTEX_SPIN / ADAPTIVE_MUTEX_MCS)
+ */
+    int mode;
+/*!
+ * @brief current spin limit (number of tries before thread parks)
+ */
+    atomic_int spin_limit;
+/*!
+ * @brief last node of MCS queue of spinning threads, NULL if nobody spins
+ */
+    _Alignas(ADAPTIVE_MUTEX_CACHE_LINE) _Atomic(struct mcs_node *) tail;
+/*!
+ * @brief number of locks that got mutex at first try
+ */
+    _Alignas(ADAPTIVE_MUTEX_CACHE_LINE) atomic_llong fast_count;
+/*!
+ * @brief number of locks that got mutex while spinning
+ */
+    atomic_llong spin_count;
+/*!
+ * @brief number of locks that parked thread in kernel
+ */
+    atomic_llong park_count;
+};
+
+void adaptive_mutex_init(struct adaptive_mutex *mutex, int mode);
+void adaptive_mutex_destroy(struct adaptive_mutex *mutex);
+void adaptive_mutex_lock(struct adaptive_mutex *mutex);
+void adaptive_mutex_unlock(struct adaptive_mutex *mutex);
+void adaptive_mutex_print_stats(struct adaptive_mutex *mutex);
+int adaptive_mutex_mode(const char *name);
+
+#endif
@@ -0,0 +1,124 @@
+#!/bin/sh
+#
+# Readers and Writers - benchmark sweep
+#
+# Runs both implementations in benchmark mode for every combination of backend, number of writers, number of readers
+# and hold time (the same reading and writing time, in nanoseconds) and writes one result per run - admissions per
+# second and p99 of queue wait (in milliseconds) of readers and writers, CPU time (in seconds) and context switches of
+# process - to CSV file, or to JSON file if output file name ends with .json. Every run uses the same seed, so results of two
+# releases can be compared line by line.
+#
+# Usage: bench.sh binary_1 binary_2 [output_file]
+#
+# Sweep can be changed with environment variables (lists are separated with spaces):
+# BENCH_BACKENDS, BENCH_WRITERS, BENCH_READERS, BENCH_HOLDS, BENCH_DURATION (seconds of every run), BENCH_SEED and
+# BENCH_READ_WINDOW (read window of implementation 1 in nanoseconds).
+#
+# Author: Mateusz Wawreszuk
+
+if [ $# -lt 2 ]; then
+    echo "Usage: bench.sh binary_1 binary_2 [output_file]"
+    exit 1
+fi
+
+binary_1=$1
+binary_2=$2
+output=${3:-bench_results.csv}
+
+backends=${BENCH_BACKENDS:-"native pthread phasefair fifo librarian"}
+writers_counts=${BENCH_WRITERS:-"1 4"}
+readers_counts=${BENCH_READERS:-"1 4 16"}
+holds=${BENCH_HOLDS:-"0 1000 10000"}
+duration=${BENCH_DURATION:-1}
+seed=${BENCH_SEED:-1}
+read_window=${BENCH_READ_WINDOW:-100000}
+
+case $output in
+    *.json) format=json ;;
+    *) format=csv ;;
+esac
+
+results=$(mktemp)
+trap 'rm -f "$results"' EXIT
+
+for implementation in 1 2; do
+    for backend in $backends; do
+        for writers in $writers_counts; do
+            for readers in $readers_counts; do
+                for hold in $holds; do
+                    if [ $implementation -eq 1 ]; then
+                        binary=$binary_1
+                        work="$hold $hold $hold $hold $read_window $read_window"
+                    else
+                        binary=$binary_2
+                        work="$hold $hold $hold $hold"
+                    fi
+                    echo "Implementation $implementation, backend $backend, $writers writers, $readers readers," \
+                         "hold $hold ns" >&2
+                    if ! run=$("$binary" "$writers" "$readers" -work $work -bench "$duration" -seed "$seed" \
+                               -backend "$backend"); then
+                        echo "Run failed:" >&2
+                        echo "$run" >&2
+                        exit 1
+                    fi
+                    echo "$run" | awk -v implementation="$implementation" -v backend="$backend" \
+                                      -v writers="$writers" -v readers="$readers" -v hold="$hold" '
+                        /^Readers queue wait/ { readers_p99 = $6 }
+                        /^Writers queue wait/ { writers_p99 = $6 }
+                        /^Readers admissions/ { readers_throughput = $4 }
+                        /^Writers admissions/ { writers_throughput = $4 }
+                        /^Process/ { user_time = $2; system_time = $3; voluntary = $4; involuntary = $5 }
+                        END {
+                            print implementation, backend, writers, readers, hold, readers_throughput,
+                                  writers_throughput, readers_p99, writers_p99, user_time, system_time, voluntary,
+                                  involuntary
+                        }' >> "$results"
+                done
+            done
+        done
+    done
+done
+
+awk -v format="$format" '
+    BEGIN {
+        split("implementation backend writers readers hold_ns readers_per_second writers_per_second " \
+              "readers_p99_wait_ms writers_p99_wait_ms user_cpu_s system_cpu_s voluntary_switches " \
+              "involuntary_switches", names, " ")
+        if (format == "csv") {
+            line = names[1]
+            for (i = 2; i <= 13; i++) {
+                line = line "," names[i]
+            }
+            print line
+        } else {
+            print "["
+        }
+    }
+    {
+        if (format == "csv") {
+            line = $1
+            for (i = 2; i <= NF; i++) {
+                line = line "," $i
+            }
+            print line
+        } else {
+            line = "  {\"" names[1] "\": " $1 ", \"" names[2] "\": \"" $2 "\""
+            for (i = 3; i <= NF; i++) {
+                line = line ", \"" names[i] "\": " $i
+            }
+            if (NR > 1) {
+                print previous ","
+            }
+            previous = line "}"
+        }
+    }
+    END {
+        if (format == "json") {
+            if (NR) {
+                print previous
+            }
+            print "]"
+        }
+    }' "$results" > "$output"
+
+echo "Results written to $output" >&2
@@ -0,0 +1,232 @@
+/*!
+ * @file
+ * Readers and Writers - latency histograms
+ *
+ * Implementation of log-bucketed histograms. Value lower than HISTOGRAM_SUB_BUCKETS is recorded in bucket with the
+ * same index. Bigger value with most significant bit at position m is recorded in one of HISTOGRAM_SUB_BUCKETS buckets
+ * of range [2^m, 2^(m+1)) chosen by HISTOGRAM_SUB_BUCKET_BITS bits following most significant one.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "histogram.h"
+
+/*!
+ * @brief Number of nanoseconds in one millisecond (values are printed in milliseconds).
+ */
+#define NANOSECONDS_IN_MILLISECOND 1000000.0
+/*!
+ * @brief Number of nanoseconds in one second (throughput is printed per second).
+ */
+#define NANOSECONDS_IN_SECOND 1000000000.0
+
+/*!
+ * @brief Function gets index of bucket for value.
+ *
+ * @param value Value (negative values are recorded as 0)
+ * @return Bucket index
+ */
+static int get_bucket(int64_t value) {
+    if (value < HISTOGRAM_SUB_BUCKETS) {
+        return value < 0 ? 0 : (int) value;
+    }
+    int magnitude = 63 - __builtin_clzll((unsigned long long) value);
+    if (magnitude > HISTOGRAM_MAX_MAGNITUDE) {
+        return HISTOGRAM_BUCKETS - 1;
+    }
+    int shift = magnitude - HISTOGRAM_SUB_BUCKET_BITS;
+    return (shift + 1) * HISTOGRAM_SUB_BUCKETS + (int) ((value >> shift) - HISTOGRAM_SUB_BUCKETS);
+}
+
+/*!
+ * @brief Function gets highest value recorded in bucket.
+ *
+ * @param bucket Bucket index
+ * @return Highest value that is recorded in bucket
+ */
+static int64_t get_bucket_highest_value(int bucket) {
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket;
+    }
+    int shift = bucket / HISTOGRAM_SUB_BUCKETS - 1;
+    int64_t lowest = (int64_t) (bucket % HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BUCKETS) << shift;
+    return lowest + ((int64_t) 1 << shift) - 1;
+}
+
+/*!
+ * @brief Resets all histogram buckets.
+ *
+ * @param histogram Histogram
+ */
+void histogram_init(struct histogram *histogram) {
+    for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+        atomic_init(&histogram->counts[i], 0);
+    }
+    atomic_init(&histogram->max, 0);
+}
+
+/*!
+ * @brief Records value in histogram. Only one thread can record values in given histogram.
+ *
+ * @param histogram Histogram
+ * @param value Value in nanoseconds
+ */
+void histogram_record(struct histogram *histogram, int64_t value) {
+    atomic_ullong *count = &histogram->counts[get_bucket(value)];
+    atomic_store_explicit(count, atomic_load_explicit(count, memory_order_relaxed) + 1, memory_order_relaxed);
+    if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Adds all values recorded in one histogram to another. Source histogram can be recorded in at the same time.
+ *
+ * @param to Histogram that values are added to (it can not be recorded in by any other thread)
+ * @param from Histogram that values are taken from
+ */
+void histogram_merge(struct histogram *to, struct histogram *from) {
+    for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+        unsigned long long count = atomic_load_explicit(&from->counts[i], memory_order_relaxed);
+        if (count) {
+            atomic_store_explicit(&to->counts[i],
+                                  atomic_load_explicit(&to->counts[i], memory_order_relaxed) + count,
+                                  memory_order_relaxed);
+        }
+    }
+    long long max = atomic_load_explicit(&from->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&to->max, memory_order_relaxed)) {
+        atomic_store_explicit(&to->max, max, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Function counts values recorded in histogram.
+ *
+ * @param histogram Histogram
+ * @return Number of recorded values
+ */
+uint64_t histogram_count(struct histogram *histogram) {
+    uint64_t count = 0;
+    for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+        count += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+    }
+    return count;
+}
+
+/*!
+ * @brief Function gets value below which given percent of recorded values is (highest value of bucket, but not more
+ * than maximum recorded value).
+ *
+ * @param histogram Histogram
+ * @param percentile Percent of values (0 - 100)
+ * @return Value in nanoseconds (0 if histogram is empty)
+ */
+int64_t histogram_percentile(struct histogram *histogram, double percentile) {
+    uint64_t count = histogram_count(histogram);
+    if (!count) {
+        return 0;
+    }
+    uint64_t wanted = (uint64_t) (percentile / 100.0 * (double) count + 0.5);
+    if (wanted < 1) {
+        wanted = 1;
+    }
+    int64_t max = atomic_load_explicit(&histogram->max, memory_order_relaxed);
+    uint64_t seen = 0;
+    for (int i = 0;i < HISTOGRAM_BUCKETS;i++) {
+        seen += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+        if (seen >= wanted) {
+            int64_t value = get_bucket_highest_value(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
+/*!
+ * @brief Prints header of table printed by histogram_print.
+ */
+void histogram_print_header() {
+    printf("%-24s %10s %12s %12s %12s %12s\n", "Latency (ms)", "count", "p50", "p99", "p999", "max");
+}
+
+/*!
+ * @brief Prints one table row with number of values, p50, p99, p999 and maximum (in milliseconds).
+ *
+ * @param name Row name
+ * @param histogram Histogram
+ */
+void histogram_print(const char *name, struct histogram *histogram) {
+    printf("%-24s %10llu %12.3f %12.3f %12.3f %12.3f\n", name, (unsigned long long) histogram_count(histogram),
+           histogram_percentile(histogram, 50.0) / NANOSECONDS_IN_MILLISECOND,
+           histogram_percentile(histogram, 99.0) / NANOSECONDS_IN_MILLISECOND,
+           histogram_percentile(histogram, 99.9) / NANOSECONDS_IN_MILLISECOND,
+           atomic_load_explicit(&histogram->max, memory_order_relaxed) / NANOSECONDS_IN_MILLISECOND);
+}
+
+/*!
+ * @brief Merges latency histograms of all threads of one role (readers or writers) and prints queue wait and in
+ * library rows.
+ *
+ * @param role Role name (printed at the beginning of rows)
+ * @param latencies Array of latency histograms of every thread
+ * @param count Number of threads
+ */
+void latency_print(const char *role, struct latency_histograms *latencies, int count) {
+    struct latency_histograms *merged = aligned_alloc(HISTOGRAM_CACHE_LINE, sizeof(struct latency_histograms));
+    histogram_init(&merged->queue_wait);
+    histogram_init(&merged->in_library);
+    for (int i = 0;i < count;i++) {
+        histogram_merge(&merged->queue_wait, &latencies[i].queue_wait);
+        histogram_merge(&merged->in_library, &latencies[i].in_library);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "%s queue wait", role);
+    histogram_print(name, &merged->queue_wait);
+    snprintf(name, sizeof(name), "%s in library", role);
+    histogram_print(name, &merged->in_library);
+    free(merged);
+}
+
+/*!
+ * @brief Prints header of table printed by throughput_print.
+ */
+void throughput_print_header() {
+    printf("%-24s %10s %12s\n", "Throughput", "count", "per second");
+}
+
+/*!
+ * @brief Counts admissions to library of all threads of one role (every admission records one value in queue wait
+ * histogram) and prints their number and number of admissions per second.
+ *
+ * @param role Role name (printed at the beginning of row)
+ * @param latencies Array of latency histograms of every thread
+ * @param count Number of threads
+ * @param elapsed Time in nanoseconds that admissions were counted for
+ */
+void throughput_print(const char *role, struct latency_histograms *latencies, int count, int64_t elapsed) {
+    uint64_t admissions = 0;
+    for (int i = 0;i < count;i++) {
+        admissions += histogram_count(&latencies[i].queue_wait);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "%s admissions", role);
+    printf("%-24s %10llu %12.1f\n", name, (unsigned long long) admissions,
+           elapsed > 0 ? admissions * NANOSECONDS_IN_SECOND / elapsed : 0.0);
+}
+
+/*!
+ * @brief Prints CPU time (user and system, in seconds) and numbers of voluntary and involuntary context switches of
+ * whole process so far (see getrusage), so throughput can be compared with its cost.
+ */
+void throughput_print_resources() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-24s %10s %12s %12s %12s\n", "Resources", "user (s)", "system (s)", "voluntary", "involuntary");
+    printf("%-24s %10.3f %12.3f %12ld %12ld\n", "Process", usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6, usage.ru_nvcsw, usage.ru_nivcsw);
+}
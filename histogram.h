@@ -0,0 +1,83 @@
+/*!
+ * @file
+ * Readers and Writers - latency histograms
+ *
+ * Log-bucketed (HDR-style) histograms of nanosecond values. Every power of two range is split into
+ * HISTOGRAM_SUB_BUCKETS linear buckets, so relative error of reported value is below 1 / HISTOGRAM_SUB_BUCKETS. Each
+ * histogram has exactly one writer (its owner thread) - recording is a relaxed load and store, no shared writes and no
+ * locks. Any other thread can merge histograms at any time to get percentiles.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*!
+ * @brief Number of bits of value kept exactly in every power of two range.
+ */
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+/*!
+ * @brief Number of linear buckets in every power of two range.
+ */
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BUCKET_BITS)
+/*!
+ * @brief Highest recorded power of two - values from 2^48 ns (about 78 hours) are recorded in last bucket.
+ */
+#define HISTOGRAM_MAX_MAGNITUDE 47
+/*!
+ * @brief Number of buckets in histogram.
+ */
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_MAGNITUDE - HISTOGRAM_SUB_BUCKET_BITS + 2) * HISTOGRAM_SUB_BUCKETS)
+/*!
+ * @brief Cache line size - every histogram starts at its own cache line, so histograms of different threads placed in
+ * one array do not share cache lines (building with -DHISTOGRAM_CACHE_LINE=8 packs them).
+ */
+#ifndef HISTOGRAM_CACHE_LINE
+#define HISTOGRAM_CACHE_LINE 64
+#endif
+
+/*!
+ * @brief Histogram of nanosecond values.
+ */
+struct histogram {
+/*!
+ * @brief number of recorded values in every bucket
+ */
+    _Alignas(HISTOGRAM_CACHE_LINE) atomic_ullong counts[HISTOGRAM_BUCKETS];
+/*!
+ * @brief maximum recorded value
+ */
+    atomic_llong max;
+};
+
+/*!
+ * @brief Latency histograms of one reader or writer.
+ */
+struct latency_histograms {
+/*!
+ * @brief time from getting to queue to being let in to library
+ */
+    struct histogram queue_wait;
+/*!
+ * @brief time spent in library
+ */
+    struct histogram in_library;
+};
+
+void histogram_init(struct histogram *histogram);
+void histogram_record(struct histogram *histogram, int64_t value);
+void histogram_merge(struct histogram *to, struct histogram *from);
+uint64_t histogram_count(struct histogram *histogram);
+int64_t histogram_percentile(struct histogram *histogram, double percentile);
+void histogram_print_header();
+void histogram_print(const char *name, struct histogram *histogram);
+void latency_print(const char *role, struct latency_histograms *latencies, int count);
+void throughput_print_header();
+void throughput_print(const char *role, struct latency_histograms *latencies, int count, int64_t elapsed);
+void throughput_print_resources();
+
+#endif
@@ -0,0 +1,412 @@
+/*!
+ * @file
+ * Readers and Writers - metrics export
+ *
+ * Implementation of metrics export. Exporter thread waits in poll - for client of Unix socket, or only for timeout when
+ * metrics are exported to file. Snapshot is written to memory stream first and then sent to client (without SIGPIPE
+ * if client has gone) or written to temporary file renamed over metrics file, so reader of file never sees it half
+ * written.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "metrics.h"
+
+/*!
+ * @brief Prefix of target that makes exporter listen on Unix socket.
+ */
+#define METRICS_SOCKET_PREFIX "unix:"
+/*!
+ * @brief Cache line size - gauges of every library start at theirs own cache line.
+ */
+#define METRICS_CACHE_LINE 64
+/*!
+ * @brief Number of nanoseconds in one second.
+ */
+#define METRICS_NANOSECONDS_IN_SECOND 1000000000LL
+
+/*!
+ * @brief Gauges of one library.
+ */
+struct metrics_library {
+/*!
+ * @brief number of readers in queue
+ */
+    _Alignas(METRICS_CACHE_LINE) atomic_int readers_queue;
+/*!
+ * @brief number of writers in queue
+ */
+    atomic_int writers_queue;
+/*!
+ * @brief number of readers in library
+ */
+    atomic_int readers_in_library;
+/*!
+ * @brief number of writers in library
+ */
+    atomic_int writers_in_library;
+};
+
+/*!
+ * @brief Flag set by metrics_start - without it all functions do nothing.
+ */
+static int is_started = 0;
+/*!
+ * @brief Path of metrics file or Unix socket.
+ */
+static const char *path;
+/*!
+ * @brief Path of temporary file renamed over metrics file (file export).
+ */
+static char *temporary_path;
+/*!
+ * @brief Listening Unix socket (-1 if metrics are exported to file).
+ */
+static int listening_socket = -1;
+/*!
+ * @brief Gauges of every library.
+ */
+static struct metrics_library *gauges;
+/*!
+ * @brief Number of libraries.
+ */
+static int libraries_count;
+/*!
+ * @brief Number of readers.
+ */
+static int readers_count;
+/*!
+ * @brief Number of writers.
+ */
+static int writers_count;
+/*!
+ * @brief Latency histograms of readers (admissions are counted from them).
+ */
+static struct latency_histograms *readers_latency;
+/*!
+ * @brief Latency histograms of writers (admissions are counted from them).
+ */
+static struct latency_histograms *writers_latency;
+/*!
+ * @brief Queue timestamp of every writer that is waiting to be let in (0 if writer does not wait).
+ */
+static atomic_llong *writers_enqueued_at;
+/*!
+ * @brief Number of visits that had to block, for every role.
+ */
+static atomic_llong waits_count[2];
+/*!
+ * @brief Number of phases started, for every role (phase of role starts when its client is let in after client of
+ * other role).
+ */
+static atomic_llong phase_switches_count[2];
+/*!
+ * @brief Flag set when exporter thread should finish.
+ */
+static atomic_int stopping;
+/*!
+ * @brief Exporter thread.
+ */
+static pthread_t exporter_t;
+
+/*!
+ * @brief Function gets timestamp (in nanoseconds) from monotonic clock - the same clock as queue timestamps of
+ * program.
+ *
+ * @return Timestamp in nanoseconds
+ */
+static int64_t get_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * METRICS_NANOSECONDS_IN_SECOND + now.tv_nsec;
+}
+
+/*!
+ * @brief Function sums admissions of all readers or writers (counts of theirs queue wait histograms).
+ *
+ * @param latencies Latency histograms of readers or writers
+ * @param count Number of readers or writers
+ * @return Number of admissions
+ */
+static unsigned long long count_admissions(struct latency_histograms *latencies, int count) {
+    unsigned long long admissions = 0;
+    for (int i = 0;i < count;i++) {
+        admissions += histogram_count(&latencies[i].queue_wait);
+    }
+    return admissions;
+}
+
+/*!
+ * @brief Writes snapshot of all metrics in Prometheus text format.
+ *
+ * @param out Stream
+ */
+static void write_metrics(FILE *out) {
+    const char *roles[2] = {"reader", "writer"};
+    unsigned long long admissions[2] = {count_admissions(readers_latency, readers_count),
+                                        count_admissions(writers_latency, writers_count)};
+    int role, i;
+    fprintf(out, "# TYPE rw_admissions_total counter\n");
+    for (role = 0;role < 2;role++) {
+        fprintf(out, "rw_admissions_total{role=\"%s\"} %llu\n", roles[role], admissions[role]);
+    }
+    fprintf(out, "# TYPE rw_waits_total counter\n");
+    for (role = 0;role < 2;role++) {
+        fprintf(out, "rw_waits_total{role=\"%s\"} %lld\n", roles[role], atomic_load(&waits_count[role]));
+    }
+    fprintf(out, "# TYPE rw_phase_switches_total counter\n");
+    for (role = 0;role < 2;role++) {
+        fprintf(out, "rw_phase_switches_total{role=\"%s\"} %lld\n", roles[role],
+                atomic_load(&phase_switches_count[role]));
+    }
+    fprintf(out, "# TYPE rw_queue_depth gauge\n");
+    for (i = 0;i < libraries_count;i++) {
+        fprintf(out, "rw_queue_depth{library=\"%i\",role=\"reader\"} %i\n", i,
+                atomic_load_explicit(&gauges[i].readers_queue, memory_order_relaxed));
+        fprintf(out, "rw_queue_depth{library=\"%i\",role=\"writer\"} %i\n", i,
+                atomic_load_explicit(&gauges[i].writers_queue, memory_order_relaxed));
+    }
+    fprintf(out, "# TYPE rw_occupancy gauge\n");
+    for (i = 0;i < libraries_count;i++) {
+        fprintf(out, "rw_occupancy{library=\"%i\",role=\"reader\"} %i\n", i,
+                atomic_load_explicit(&gauges[i].readers_in_library, memory_order_relaxed));
+        fprintf(out, "rw_occupancy{library=\"%i\",role=\"writer\"} %i\n", i,
+                atomic_load_explicit(&gauges[i].writers_in_library, memory_order_relaxed));
+    }
+    int64_t now = get_now();
+    double max_age = 0.0;
+    fprintf(out, "# TYPE rw_writer_starvation_seconds gauge\n");
+    for (i = 0;i < writers_count;i++) {
+        int64_t enqueued_at = atomic_load_explicit(&writers_enqueued_at[i], memory_order_relaxed);
+        double age = enqueued_at && now > enqueued_at ?
+                     (double) (now - enqueued_at) / METRICS_NANOSECONDS_IN_SECOND : 0.0;
+        if (age > max_age) {
+            max_age = age;
+        }
+        fprintf(out, "rw_writer_starvation_seconds{writer=\"%i\"} %.6f\n", i, age);
+    }
+    fprintf(out, "# TYPE rw_writer_starvation_max_seconds gauge\n");
+    fprintf(out, "rw_writer_starvation_max_seconds %.6f\n", max_age);
+}
+
+/*!
+ * @brief Sends snapshot of metrics to client of Unix socket and closes connection.
+ *
+ * @param client Socket of client
+ */
+static void serve_client(int client) {
+    char *buffer;
+    size_t size;
+    FILE *out = open_memstream(&buffer, &size);
+    write_metrics(out);
+    fclose(out);
+    size_t sent = 0;
+    while (sent < size) {
+        ssize_t result = send(client, buffer + sent, size - sent, MSG_NOSIGNAL);
+        if (result <= 0) {
+            break;
+        }
+        sent += result;
+    }
+    free(buffer);
+    close(client);
+}
+
+/*!
+ * @brief Writes snapshot of metrics to temporary file and renames it over metrics file.
+ */
+static void export_file() {
+    FILE *out = fopen(temporary_path, "w");
+    if (!out) {
+        return;
+    }
+    write_metrics(out);
+    fclose(out);
+    rename(temporary_path, path);
+}
+
+/*!
+ * @brief Exporter thread. It serves every client of Unix socket or rewrites metrics file every METRICS_INTERVAL,
+ * until stopping flag is set (it is checked at least every METRICS_POLL_TIMEOUT).
+ *
+ * @return NULL
+ */
+static void* exporter() {
+    int64_t next_export = 0;
+    while (!atomic_load(&stopping)) {
+        if (listening_socket >= 0) {
+            struct pollfd listening = {listening_socket, POLLIN, 0};
+            if (poll(&listening, 1, METRICS_POLL_TIMEOUT) > 0) {
+                int client = accept(listening_socket, NULL, NULL);
+                if (client >= 0) {
+                    serve_client(client);
+                }
+            }
+        } else {
+            if (get_now() >= next_export) {
+                export_file();
+                next_export = get_now() + METRICS_INTERVAL * (METRICS_NANOSECONDS_IN_SECOND / 1000);
+            }
+            poll(NULL, 0, METRICS_POLL_TIMEOUT);
+        }
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Allocates metrics and starts exporter thread (with all signals blocked, so signals are still received only
+ * by main thread).
+ *
+ * @param target Metrics file path or "unix:" followed by Unix socket path
+ * @param libraries Number of libraries
+ * @param readers Number of readers
+ * @param writers Number of writers
+ * @param readers_histograms Latency histograms of readers
+ * @param writers_histograms Latency histograms of writers
+ * @return 0 if exporter was started, -1 if Unix socket can not be created
+ */
+int metrics_start(const char *target, int libraries, int readers, int writers,
+                  struct latency_histograms *readers_histograms, struct latency_histograms *writers_histograms) {
+    size_t prefix_length = strlen(METRICS_SOCKET_PREFIX);
+    if (strncmp(target, METRICS_SOCKET_PREFIX, prefix_length) == 0) {
+        path = target + prefix_length;
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (!*path || strlen(path) >= sizeof(address.sun_path)) {
+            return -1;
+        }
+        strcpy(address.sun_path, path);
+        listening_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+        unlink(path);
+        if (listening_socket < 0 || bind(listening_socket, (struct sockaddr *) &address, sizeof(address)) < 0 ||
+            listen(listening_socket, SOMAXCONN) < 0) {
+            if (listening_socket >= 0) {
+                close(listening_socket);
+            }
+            listening_socket = -1;
+            return -1;
+        }
+    } else {
+        path = target;
+        temporary_path = malloc(strlen(path) + 5);
+        sprintf(temporary_path, "%s.tmp", path);
+    }
+    libraries_count = libraries;
+    readers_count = readers;
+    writers_count = writers;
+    readers_latency = readers_histograms;
+    writers_latency = writers_histograms;
+    gauges = aligned_alloc(METRICS_CACHE_LINE, libraries_count * sizeof(struct metrics_library));
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        atomic_init(&gauges[i].readers_queue, 0);
+        atomic_init(&gauges[i].writers_queue, 0);
+        atomic_init(&gauges[i].readers_in_library, 0);
+        atomic_init(&gauges[i].writers_in_library, 0);
+    }
+    writers_enqueued_at = malloc(writers_count * sizeof(atomic_llong));
+    for (i = 0;i < writers_count;i++) {
+        atomic_init(&writers_enqueued_at[i], 0);
+    }
+    for (i = 0;i < 2;i++) {
+        atomic_init(&waits_count[i], 0);
+        atomic_init(&phase_switches_count[i], 0);
+    }
+    atomic_init(&stopping, 0);
+    is_started = 1;
+    sigset_t all_signals, previous_signals;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_BLOCK, &all_signals, &previous_signals);
+    pthread_create(&exporter_t, NULL, exporter, NULL);
+    pthread_sigmask(SIG_SETMASK, &previous_signals, NULL);
+    return 0;
+}
+
+/*!
+ * @brief Counts visit of reader or writer that has to block before it is let in.
+ *
+ * @param role Role (METRICS_READER / METRICS_WRITER)
+ */
+void metrics_count_wait(int role) {
+    if (is_started) {
+        atomic_fetch_add_explicit(&waits_count[role], 1, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Counts start of phase of readers or writers.
+ *
+ * @param role Role whose phase starts (METRICS_READER / METRICS_WRITER)
+ */
+void metrics_count_phase_switch(int role) {
+    if (is_started) {
+        atomic_fetch_add_explicit(&phase_switches_count[role], 1, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Stores queue depth and occupancy of library. It is called with mutex of library locked, so stores of one
+ * library never race with each other.
+ *
+ * @param library Library number
+ * @param readers_queue Number of readers in queue
+ * @param writers_queue Number of writers in queue
+ * @param readers_in_library Number of readers in library
+ * @param writers_in_library Number of writers in library
+ */
+void metrics_set_library(int library, int readers_queue, int writers_queue, int readers_in_library,
+                         int writers_in_library) {
+    if (is_started) {
+        atomic_store_explicit(&gauges[library].readers_queue, readers_queue, memory_order_relaxed);
+        atomic_store_explicit(&gauges[library].writers_queue, writers_queue, memory_order_relaxed);
+        atomic_store_explicit(&gauges[library].readers_in_library, readers_in_library, memory_order_relaxed);
+        atomic_store_explicit(&gauges[library].writers_in_library, writers_in_library, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Stores queue timestamp of writer - starvation age of writer is counted from it.
+ *
+ * @param writer_id Writer id
+ * @param enqueued_at Queue timestamp (monotonic clock, in nanoseconds) or 0 when writer stops waiting
+ */
+void metrics_writer_queued(int writer_id, int64_t enqueued_at) {
+    if (is_started) {
+        atomic_store_explicit(&writers_enqueued_at[writer_id], enqueued_at, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Stops exporter thread (file is rewritten once more, so it holds final values) and frees metrics. All readers
+ * and writers have to be finished before.
+ */
+void metrics_stop() {
+    if (!is_started) {
+        return;
+    }
+    atomic_store(&stopping, 1);
+    pthread_join(exporter_t, NULL);
+    is_started = 0;
+    if (listening_socket >= 0) {
+        close(listening_socket);
+        unlink(path);
+    } else {
+        export_file();
+        free(temporary_path);
+    }
+    free(gauges);
+    free(writers_enqueued_at);
+}
@@ -0,0 +1,55 @@
+/*!
+ * @file
+ * Readers and Writers - metrics export
+ *
+ * Counters and gauges of running program exported by background exporter thread - to a file rewritten every
+ * METRICS_INTERVAL or to every client connecting to a Unix socket (target "unix:path"), in Prometheus text format.
+ * Everything exporter reads is atomic (or lock-free, like latency histograms), so exporting never takes library
+ * mutex:
+ * - admissions of readers and writers are counted from theirs latency histograms,
+ * - waits (visits that had to block) and phase switches are counted with relaxed atomic adds - only on paths that
+ * block anyway,
+ * - queue depth and occupancy of every library are stored (relaxed) by program on every state change, under mutex of
+ * library it already holds,
+ * - starvation age of every writer is computed from its queue timestamp stored when it starts to wait.
+ * Until metrics_start is called all functions do nothing.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+
+#include "histogram.h"
+
+/*!
+ * @brief Reader role.
+ */
+#define METRICS_READER 0
+/*!
+ * @brief Writer role.
+ */
+#define METRICS_WRITER 1
+
+/*!
+ * @brief Time (in milliseconds) between rewrites of metrics file.
+ */
+#define METRICS_INTERVAL 1000
+/*!
+ * @brief Time (in milliseconds) that exporter thread waits for client (or next rewrite) before it checks if it should
+ * finish.
+ */
+#define METRICS_POLL_TIMEOUT 100
+
+int metrics_start(const char *target, int libraries_count, int readers_count, int writers_count,
+                  struct latency_histograms *readers_latency, struct latency_histograms *writers_latency);
+void metrics_count_wait(int role);
+void metrics_count_phase_switch(int role);
+void metrics_set_library(int library, int readers_queue, int writers_queue, int readers_in_library,
+                         int writers_in_library);
+void metrics_writer_queued(int writer_id, int64_t enqueued_at);
+void metrics_stop();
+
+#endif
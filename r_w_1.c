@@ -5,7 +5,7 @@
  * Implementation with no starvation of writers or readers. It uses conditional variables - one for readers and one for
  * each writer. In this implementation there is an additional thread - librarian. It waits for some (default random) time
  * allowing readers to use library. When time ends - it stops letting readers to enter library. When library is empty -
- * librarian looks for writer with maximum waiting time and lets him in.
+ * librarian takes writer with maximum waiting time from priority queue (min-heap) and lets him in.
  *
  * @author Mateusz Wawreszuk
  */
@@ -31,49 +31,577 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "status_log.h"
+#include "histogram.h"
+#include "rng.h"
+#include "rw_lock.h"
+#include "task_pool.h"
+#include "adaptive_mutex.h"
+#include "topology.h"
+#include "trace.h"
+#include "seqlock.h"
+#include "metrics.h"
+
+/*!
+ * @brief Number of nanoseconds in one second.
+ */
+#define NANOSECONDS_IN_SECOND 1000000000LL
+
+/*!
+ * @brief Number of nanoseconds in one millisecond.
+ */
+#define NANOSECONDS_IN_MILLISECOND 1000000LL
+
+/*!
+ * @brief Period (in nanoseconds) of librarian's checks of library during read window in adaptive mode.
+ */
+#define LIBRARIAN_TICK NANOSECONDS_IN_MILLISECOND
+/*!
+ * @brief Number of last writers queue waits that adaptive librarian computes p99 of.
+ */
+#define LIBRARIAN_WAITS 128
+/*!
+ * @brief Time (in nanoseconds) that optimistic reader sleeps (in standard mode) before it checks again if writer has
+ * finished writing (seqlock mode).
+ */
+#define SEQLOCK_BACKOFF_TIME NANOSECONDS_IN_MILLISECOND
+
+/*!
+ * @brief Time (in nanoseconds) that client which gave up its visit at deadline waits before it arrives again (deadline
+ * mode). It doubles with every next visit given up in a row, up to DEADLINE_MAX_BACKOFF_TIME (see back_off).
+ */
+#define DEADLINE_BACKOFF_TIME (NANOSECONDS_IN_MILLISECOND / 10)
+/*!
+ * @brief Maximal time (in nanoseconds) that client which gave up its visit at deadline waits before it arrives again.
+ */
+#define DEADLINE_MAX_BACKOFF_TIME (100 * NANOSECONDS_IN_MILLISECOND)
+
+/*!
+ * @brief Number of library state changes that can wait in status log for printing.
+ */
+#define STATUS_LOG_CAPACITY 65536
+
+/*!
+ * @brief Cache line size - reader slots (see struct reader_slot) are aligned to it.
+ */
+#define CACHE_LINE_SIZE 64
+
+/*!
+ * @brief Alignment of readers and writers states (see struct reader_state and struct writer_state) - one cache line,
+ * so states of neighbouring threads never share a line. Building with -DTHREAD_STATE_ALIGNMENT=8 packs states (no
+ * padding), so benchmark can compare both layouts (see bench target in Makefile).
+ */
+#ifndef THREAD_STATE_ALIGNMENT
+#define THREAD_STATE_ALIGNMENT CACHE_LINE_SIZE
+#endif
+
+/*!
+ * @brief Task step: reader or writer waits to enter library (writer - till librarian lets it in).
+ */
+#define CLIENT_WAITING 0
+/*!
+ * @brief Task step: writer let in by librarian waits till readers leave library.
+ */
+#define CLIENT_DRAINING 1
+/*!
+ * @brief Task step: reader or writer is in library.
+ */
+#define CLIENT_IN_LIBRARY 2
 
 /*!
  * @brief Wrong arguments error message.
  */
-#define ERROR_ARGUMENTS_MESSAGE "Usage: ReaderAndWriters1 number_of_writers number_of_readers [-t min_reading_time max_reading_time min_writing_time max_writing_time min_allow_read_time max_allow_read_time] [-debug]\n"
+#define ERROR_ARGUMENTS_MESSAGE "Usage: ReaderAndWriters1 number_of_writers number_of_readers [-t min_reading_time max_reading_time min_writing_time max_writing_time min_allow_read_time max_allow_read_time] [-work min_reading_ns max_reading_ns min_writing_ns max_writing_ns min_allow_read_ns max_allow_read_ns] [-debug] [-stats interval] [-bench seconds] [-ops count] [-seed number] [-dist uniform|exp|pareto] [-backend native|pthread|phasefair|fifo|librarian] [-brlock] [-tasks workers] [-wakebatch count] [-mutex pthread|adaptive|mcs] [-pin none|cpu|node] [-cohort] [-trace file] [-adaptive target_p99_ms] [-libraries count] [-zipf exponent] [-deadline ms] [-seqlock] [-metrics file|unix:socket]\n"
+
+/*!
+ * @brief Reader's slot used in big-reader lock mode. Every slot is in its own cache line and is written only by its own
+ * reader, so entering and leaving library does not write any shared cache line.
+ */
+struct reader_slot {
+/*!
+ * @brief timestamp set when reader enters library, 0 when reader is not in library
+ */
+    _Alignas(CACHE_LINE_SIZE) atomic_llong in_library;
+/*!
+ * @brief timestamp set when reader gets to queue
+ */
+    atomic_llong queue;
+/*!
+ * @brief position in *libraries of library that reader is registered in (see get_readers_in_library_count)
+ */
+    atomic_int library;
+};
+
+/*!
+ * @brief Reader's state. State of every reader starts at its own cache line - it is written by its reader on every
+ * entering and leaving library, so in packed arrays neighbouring readers would false share cache lines. Timestamps are
+ * in the first line, fields used to wake reader up in wake batch mode follow them.
+ */
+struct reader_state {
+/*!
+ * @brief timestamp set when reader enters library, 0 if reader is not in library
+ */
+    _Alignas(THREAD_STATE_ALIGNMENT) int64_t in_library;
+/*!
+ * @brief timestamp set when reader starts waiting to enter library, 0 if reader is not in queue
+ */
+    int64_t queue;
+/*!
+ * @brief conditional variable that reader waits on till it is woken up (wake batch mode)
+ */
+    pthread_cond_t cond;
+/*!
+ * @brief flag set when reader is taken from *waiting_readers and woken up (wake batch mode)
+ */
+    int woken;
+};
+
+/*!
+ * @brief Writer's state. Fields used to let writer in (conditional variable, granted flag, heap position and ticket)
+ * fill first cache line, timestamps are in the second one. State of every writer starts at its own cache line.
+ */
+struct writer_state {
+/*!
+ * @brief conditional variable that writer waits on till it is let in to library
+ */
+    _Alignas(THREAD_STATE_ALIGNMENT) pthread_cond_t cond;
+/*!
+ * @brief flag set by librarian when writer is let in to library
+ */
+    int granted;
+/*!
+ * @brief position of writer in *writers_heap of library it waits in (kept up to date by heap functions, so writer
+ * whose deadline passed takes itself off from heap without searching it, see remove_waiting_writer)
+ */
+    int heap_position;
+/*!
+ * @brief ticket taken when writer gets to queue (taken under mutex from next_writer_ticket, so tickets order is exactly
+ * the order in which writers started waiting, without ties)
+ */
+    unsigned long ticket;
+/*!
+ * @brief timestamp set when writer enters library, 0 if writer is not in library
+ */
+    int64_t in_library;
+/*!
+ * @brief timestamp set when writer starts waiting to enter library, 0 if writer is not in queue
+ */
+    int64_t queue;
+};
+
+/*!
+ * @brief Library - admission state guarded by its mutex. There is one library by default, with -libraries there are
+ * libraries_count independent libraries (resource shards) and every library has its own admission state and its own
+ * librarian thread. Reader or writer is in queue or in library of at most one library at a time, so states of readers
+ * and writers are common for all libraries. Every library starts at its own cache line, so locking one library does
+ * not invalidate its neighbours.
+ */
+struct library {
+/*!
+ * @brief just a mutex (see adaptive_mutex.h - by default plain pthread_mutex_t)
+ */
+    _Alignas(CACHE_LINE_SIZE) struct adaptive_mutex mutex;
+/*!
+ * @brief conditional variable to handle readers
+ */
+    pthread_cond_t readers_cond;
+/*!
+ * @brief conditional variable broadcast when library gets drained - when last reader leaves library or when writer
+ * leaves library (writer waits on it for readers to leave, librarian waits on it for writer to leave)
+ */
+    pthread_cond_t library_drained_cond;
+/*!
+ * @brief notifies that some writer is in library or is going to be let to the library - it is changed under mutex,
+ * but in big-reader lock mode readers read it without mutex (after registering in theirs slots), so it is atomic
+ */
+    atomic_int writer_notification;
+/*!
+ * @brief number of writers currently in library
+ */
+    int writers_in_library_count;
+/*!
+ * @brief number of readers currently in library (not used in big-reader lock mode, see get_readers_in_library_count)
+ */
+    int readers_in_library_count;
+/*!
+ * @brief number of writers in queue
+ */
+    int writers_queue_count;
+/*!
+ * @brief number of readers in queue
+ */
+    int readers_queue_count;
+/*!
+ * @brief priority queue of writers waiting to enter library - binary min-heap of writer ids ordered by theirs tickets
+ * (see struct writer_state), writer at position 0 is the one that waits for longest time
+ */
+    int *writers_heap;
+/*!
+ * @brief number of writers in *writers_heap
+ */
+    int writers_heap_size;
+/*!
+ * @brief ticket that will be given to next writer getting to queue
+ */
+    unsigned long next_writer_ticket;
+/*!
+ * @brief ids of readers waiting till writer leaves library in wake batch mode - one ring buffer for every cohort in
+ * order of waiting, ring of cohort takes positions of its readers (from topology_first_of(cohort, readers_count) up to
+ * first reader of next cohort)
+ */
+    int *waiting_readers;
+/*!
+ * @brief positions of first reader in every cohort's ring of *waiting_readers (counted from ring's beginning)
+ */
+    int *waiting_readers_head;
+/*!
+ * @brief numbers of readers in every cohort's ring of *waiting_readers
+ */
+    int *waiting_readers_count;
+/*!
+ * @brief ids of readers tasks parked till writer leaves library (task mode)
+ */
+    int *parked_readers;
+/*!
+ * @brief number of ids in *parked_readers
+ */
+    int parked_readers_count;
+/*!
+ * @brief writer task let in by librarian that is parked till readers leave library (task mode), NULL if there is no
+ * such writer
+ */
+    struct client_task *draining_writer;
+/*!
+ * @brief lock used instead of program's own scheme if lock_backend is not RW_LOCK_NATIVE
+ */
+    struct rw_lock rw_lock;
+/*!
+ * @brief current read window in nanoseconds (adaptive read window mode) - it starts at min_allow_read_time and stays
+ * between LIBRARIAN_TICK and max_allow_read_time
+ */
+    int64_t read_window;
+/*!
+ * @brief last LIBRARIAN_WAITS writers queue waits in nanoseconds (ring buffer, adaptive read window mode)
+ */
+    int64_t writer_waits[LIBRARIAN_WAITS];
+/*!
+ * @brief number of writers queue waits recorded in writer_waits (it's not reset when ring buffer is full)
+ */
+    long long writer_waits_count;
+/*!
+ * @brief number of read windows (adaptive read window mode)
+ */
+    long long read_windows_count;
+/*!
+ * @brief sum of lengths of read windows in nanoseconds (adaptive read window mode)
+ */
+    int64_t read_windows_time;
+/*!
+ * @brief number of readers that have entered library - librarian uses it to see reader arrival rate (it is counted
+ * atomically, because readers in big-reader lock mode do not lock mutex)
+ */
+    atomic_llong readers_arrivals_count;
+/*!
+ * @brief number of admissions to library (counted only if there is more than one library)
+ */
+    atomic_llong admissions_count;
+/*!
+ * @brief sequence lock of library's book - written by writers let in by librarian, read optimistically by readers
+ * (seqlock mode)
+ */
+    struct seqlock seqlock;
+};
+
+/*!
+ * @brief Reader or writer run as task on task pool (task mode). Waiting task is parked - it is neither in run queue nor
+ * in timers heap, and it is submitted again by the one who lets it go on (writer leaving library, librarian or last
+ * reader leaving library).
+ */
+struct client_task {
+/*!
+ * @brief task run by task pool (first member, so pointer to task is pointer to client_task too)
+ */
+    struct task task;
+/*!
+ * @brief reader or writer id
+ */
+    int id;
+/*!
+ * @brief step of reader or writer (CLIENT_WAITING / CLIENT_DRAINING / CLIENT_IN_LIBRARY)
+ */
+    int step;
+/*!
+ * @brief flag set when task is parked
+ */
+    int parked;
+/*!
+ * @brief random number generator of reader or writer
+ */
+    struct rng rng;
+};
 
-void print();
+void print(struct library *library);
+void print_debug();
+void print_latency();
+void print_throughput(int64_t elapsed);
+void print_libraries();
 void* reader(void* arg);
 void* writer(void* arg);
-void* librarian();
-void write_book(int writer_id);
-void read_books(int reader_id);
-int get_random(int min, int max);
-time_t get_timestamp();
+void* librarian(void* arg);
+void wait_read_window(struct library *library);
+void adapt_read_window(struct library *library);
+void record_writer_wait(struct library *library, int64_t queue_wait);
+int compare_waits(const void *first, const void *second);
+int64_t get_recent_writer_wait_p99(struct library *library);
+void print_read_windows();
+void write_book(struct library *library, int writer_id, int64_t writing_time);
+void read_books(struct library *library, int reader_id, int64_t reading_time, int64_t queue_wait);
+void write_with_lock(struct library *library, int writer_id, struct rng *rng, int64_t *backoff);
+void read_with_lock(struct library *library, int reader_id, struct rng *rng, int64_t *backoff);
+void read_books_registered(struct library *library, int reader_id, int64_t reading_time, int64_t arrived_at);
+int64_t reader_enters(struct library *library, int reader_id);
+int64_t reader_leaves(struct library *library, int reader_id);
+int64_t writer_enters(struct library *library, int writer_id);
+int64_t writer_leaves(struct library *library, int writer_id);
+void wake_writer(int writer_id);
+void wake_readers(struct library *library, int writer_id);
+void wait_for_wake_up(struct library *library, int reader_id);
+void wake_waiting_readers(struct library *library, int cohort);
+int get_reader_cohort(int reader_id);
+void get_cohort_ring(int cohort, int *first, int *size);
+int64_t wait_for_arrival(int *record, int64_t *arrived_at);
+void get_to_queue(struct library *library, int role, int id, int64_t arrived_at);
+struct library* choose_library(struct rng *rng);
+void start_tasks();
+void run_reader_task(struct task *task);
+void run_writer_task(struct task *task);
+int get_readers_in_library_count(struct library *library);
+int get_readers_queue_count(struct library *library);
+int64_t get_timestamp();
 void init_queue();
-void signal_handler();
+void push_waiting_writer(struct library *library, int writer_id);
+int pop_longest_waiting_writer(struct library *library);
+void remove_waiting_writer(struct library *library, int writer_id);
+void sift_writer_up(struct library *library, int position, int writer_id);
+void sift_writer_down(struct library *library, int position, int writer_id);
+int is_admitted(struct library *library, int role, int id);
+int wait_for_admission(struct library *library, int role, int id);
+void back_off(int64_t *backoff);
+void give_up(struct library *library, int role, int id);
+void print_deadlines();
+void read_optimistically(struct library *library, int reader_id, int64_t reading_time, int64_t arrived_at);
+void wait_for_writing(struct library *library);
+void print_seqlock();
+void sleep_interruptible(int64_t nanoseconds);
+void spend_time(int64_t duration);
+void count_admission(struct library *library);
+void wait_for_signal();
+void stop_threads();
 void args_interpreter(int argc, char **argv);
+void read_time_range(char **arguments, int64_t unit, int64_t *min, int64_t *max);
 void variables_initializer();
 void cleaner();
 
 /*!
- * @brief Loop in main function works until signal_flag is set. When SIGINT signal is received, flag is changed to 0 and
- * loop stops.
+ * @brief All threads work until signal_flag is set. When SIGINT or SIGTERM signal is received, main function changes
+ * flag to 0 (holding mutexes of all libraries and shutdown_mutex) and wakes up all waiting threads, so they can finish
+ * their loops.
+ */
+volatile int signal_flag = 1;
+
+/*!
+ * @brief Mutex guarding shutdown_cond.
+ */
+pthread_mutex_t shutdown_mutex;
+/*!
+ * @brief Conditional variable that threads wait on instead of sleep(), so they are woken up at shutdown.
  */
- volatile int signal_flag = 1;
+pthread_cond_t shutdown_cond;
 
 /*!
- * @brief Just a mutex.
+ * @brief Array of libraries (see struct library).
+ */
+struct library *libraries;
+/*!
+ * @brief Number of libraries (set by -libraries, 1 by default).
+ */
+int libraries_count = 1;
+/*!
+ * @brief Cumulative weights of libraries (see rng_zipf_weights) used to choose library when -zipf is set, NULL if
+ * every library is chosen with the same probability.
  */
-pthread_mutex_t mutex;
+double *libraries_weights = NULL;
 /*!
- * @brief Conditional variable to handle readers.
+ * @brief Exponent of Zipf distribution that libraries are chosen from (set by -zipf, 0 means uniform distribution).
  */
-pthread_cond_t readers_cond;
+double zipf_exponent = 0.0;
 /*!
- * @brief Array of conditional variables to handle writers.
+ * @brief Flag set when readers and writers get to queue at theirs arrivals, not when they leave library - in trace
+ * mode (client is not waiting till its next arrival), in deadline mode (every visit has its own deadline) and when
+ * there is more than one library (client gets to queue of library it chooses for its next visit, see get_to_queue).
  */
-pthread_cond_t *writers_conds;
+int is_queued_on_arrival = 0;
 
 /*!
  * @brief Flag marking debug mode.
  */
 int is_debug_run = 0;
+/*!
+ * @brief Interval (in seconds) of printing latency percentiles while program works. If it's 0, percentiles are printed
+ * only at the end.
+ */
+int stats_interval = 0;
+/*!
+ * @brief Flag marking benchmark mode (set by -bench or -ops). In benchmark mode time in library is spent on busy work
+ * instead of sleeping, library state is not printed and admissions per second are printed at the end.
+ */
+int is_bench_run = 0;
+/*!
+ * @brief Benchmark duration in seconds. If it's 0, program works until signal is received (or ops_limit is reached).
+ */
+int bench_duration = 0;
+/*!
+ * @brief Number of admissions to library (readers and writers together) after which program stops. If it's 0, there is
+ * no limit.
+ */
+long long ops_limit = 0;
+/*!
+ * @brief Number of admissions to library (readers and writers together). It is counted only if ops_limit is set.
+ */
+atomic_llong admissions_count = 0;
+/*!
+ * @brief Seed of random number generators (from -seed argument or from clock). Every thread seeds its own generator
+ * with it and its own stream number, so runs with the same seed draw the same times.
+ */
+uint64_t seed;
+/*!
+ * @brief Distribution of reading and writing times (RNG_UNIFORM / RNG_EXPONENTIAL / RNG_PARETO).
+ */
+int time_distribution = RNG_UNIFORM;
+/*!
+ * @brief Reader-writer lock backend (RW_LOCK_NATIVE - program's own scheme, RW_LOCK_PTHREAD, RW_LOCK_PHASE_FAIR,
+ * RW_LOCK_FIFO or RW_LOCK_LIBRARIAN).
+ */
+int lock_backend = RW_LOCK_NATIVE;
+/*!
+ * @brief Flag set when library state is printed by status log - in standard mode (not debug or benchmark) with
+ * program's own scheme (other backends do not keep library state).
+ */
+int is_status_logged = 0;
+/*!
+ * @brief Flag marking big-reader lock mode (read-mostly workloads). Readers do not lock mutex to enter and leave
+ * library - they only write theirs own slots (*readers_slots), and writer sweeps all slots to check is library drained.
+ */
+int is_big_reader_lock = 0;
+/*!
+ * @brief Flag marking task mode (set by -tasks). Readers and writers are tasks run by task_workers worker threads
+ * instead of having theirs own threads (librarian still has its own thread).
+ */
+int is_task_run = 0;
+/*!
+ * @brief Number of worker threads in task mode.
+ */
+int task_workers = 0;
+/*!
+ * @brief Mode of mutex (ADAPTIVE_MUTEX_PTHREAD / ADAPTIVE_MUTEX_SPIN / ADAPTIVE_MUTEX_MCS, set by -mutex).
+ */
+int mutex_mode = ADAPTIVE_MUTEX_PTHREAD;
+/*!
+ * @brief Number of readers woken up at once in wake batch mode (set by -wakebatch). Instead of broadcasting
+ * readers_cond, writer leaving library wakes up only wake_batch first readers from *waiting_readers and every woken
+ * reader wakes up next wake_batch readers, so phase change costs O(wake_batch) context switches instead of waking all
+ * readers to contend for mutex at once. If it's 0, readers_cond is broadcast.
+ */
+int wake_batch = 0;
+/*!
+ * @brief Pin mode of readers, writers, librarian and task pool workers (TOPOLOGY_PIN_NONE / TOPOLOGY_PIN_CPU /
+ * TOPOLOGY_PIN_NODE, set by -pin).
+ */
+int pin_mode = TOPOLOGY_PIN_NONE;
+/*!
+ * @brief Flag of cohort mode (set by -cohort, works only in wake batch mode). Readers are split into cohorts - one for
+ * every NUMA node (see topology_node_of) - and every cohort has its own part of *waiting_readers. Writer leaving
+ * library wakes up readers of its own node and woken reader wakes up next readers of its own cohort, so readers of one
+ * node enter library as a group and cohort of another node is woken up only when there is nobody left to wake up in
+ * current one.
+ */
+int is_cohort_run = 0;
+/*!
+ * @brief Number of readers cohorts (number of NUMA nodes in cohort mode, 1 otherwise).
+ */
+int cohorts_count = 1;
+/*!
+ * @brief Flag marking trace mode (set by -trace). Readers and writers replay records of trace (see trace.h) - they get
+ * to queue at arrival times of theirs records and spend hold times of records in library, so arrivals are open-loop.
+ * Writer is in *writers_heap only between its arrival and admission, so librarian lets in only writers that arrived.
+ */
+int is_trace_run = 0;
+/*!
+ * @brief Path of trace file (trace mode).
+ */
+char *trace_path;
+/*!
+ * @brief Trace replayed in trace mode.
+ */
+struct trace trace;
+/*!
+ * @brief Timestamp of start of trace replay - arrival time of record is trace_started_at + record's timestamp.
+ */
+int64_t trace_started_at;
+/*!
+ * @brief Flag marking deadline mode (set by -deadline). Reader that can not enter library before its deadline (writer
+ * phase has not ended) and writer that is not let in by librarian before its deadline give up theirs visits (writer
+ * is taken off from *writers_heap) and arrive again with next visits.
+ */
+int is_deadline_run = 0;
+/*!
+ * @brief Time (in nanoseconds) from getting to queue to deadline of visit in deadline mode. It is at least one
+ * millisecond - writer is let in only by librarian at the end of read window, so with deadline 0 (give up when client
+ * can not enter at once) no writer would ever be let in.
+ */
+int64_t deadline_time = 0;
+/*!
+ * @brief Number of readers visits that gave up at deadline (deadline mode).
+ */
+atomic_llong readers_timeouts_count = 0;
+/*!
+ * @brief Number of writers visits that gave up at deadline (deadline mode).
+ */
+atomic_llong writers_timeouts_count = 0;
+/*!
+ * @brief Flag marking seqlock mode (set by -seqlock). Readers do not get to queue, do not lock mutex and do not wait
+ * for writer phases - they read optimistically (see read_optimistically) and retry if writer was writing in the
+ * meantime. Writers are let in by librarian as before.
+ */
+int is_seqlock_run = 0;
+/*!
+ * @brief Number of optimistic reads that had to be retried (seqlock mode).
+ */
+atomic_llong seqlock_retries_count = 0;
+/*!
+ * @brief Flag marking metrics export (set by -metrics, see metrics.h).
+ */
+int is_metrics_run = 0;
+/*!
+ * @brief Metrics file path or "unix:" followed by Unix socket path (metrics export).
+ */
+char *metrics_target;
+/*!
+ * @brief Flag marking adaptive read window mode (set by -adaptive). Librarian does not draw read window - it checks
+ * library every LIBRARIAN_TICK and ends read window when it has lasted read_window since first writer was waiting or
+ * when library is empty and no reader has come since last check. After each writer phase read_window is scaled by
+ * target_writer_wait / p99 of last writers waits and limited to target_writer_wait / number of waiting writers
+ * (librarian lets in one writer per phase, so every waiting writer has to wait for one phase).
+ */
+int is_adaptive_run = 0;
+/*!
+ * @brief Target p99 of writers queue wait in nanoseconds (adaptive read window mode).
+ */
+int64_t target_writer_wait;
 
 /*!
  * @brief Number of readers.
@@ -85,87 +613,90 @@ int readers_count;
 int writers_count;
 
 /*!
- * @brief Array of timestamps to set when writer enters library. Set to 0 if writer is not in library.
+ * @brief Array of writers states (see struct writer_state).
  *
  * Position in array is an identifier of writer.
  */
-time_t *writers_in_library;
-/*!
- * @brief Number of writers currently in library.
- */
-int writers_in_library_count = 0;
+struct writer_state *writers_state;
 
 /*!
- * @brief Array of timestamps to set when reader enters library. Set to 0 if reader is not in library.
+ * @brief Array of readers states (see struct reader_state).
  *
  * Position in array is an identifier of reader.
  */
-time_t *readers_in_library;
+struct reader_state *readers_state;
 /*!
- * @brief Number of readers currently in library.
+ * @brief Array of readers slots used instead of *readers_state and readers_in_library_count in big-reader lock mode.
+ *
+ * Position in array is an identifier of reader.
  */
-int readers_in_library_count = 0;
+struct reader_slot *readers_slots;
 
 /*!
- * @brief Array of timestamps to set when writer starts waiting to enter library. Set to 0 if writer is not in queue.
+ * @brief Array of readers tasks (task mode).
+ *
+ * Position in array is an identifier of reader.
  */
-time_t *writers_queue;
+struct client_task *readers_tasks;
 /*!
- * @brief Number of writers in library.
+ * @brief Array of writers tasks (task mode).
+ *
+ * Position in array is an identifier of writer.
  */
-int writers_queue_count;
+struct client_task *writers_tasks;
 
 /*!
- * @brief Array of timestamps to set when reader starts waiting to enter library. Set to 0 if reader is not in queue.
- */
-time_t *readers_queue;
-/*!
- * @brief Number of readers in library.
+ * @brief Array of latency histograms of readers - recorded only by reader thread itself.
+ *
+ * Position in array is an identifier of reader.
  */
-int readers_queue_count;
-
+struct latency_histograms *readers_latency;
 /*!
- * @brief Notifies that some writer is in library or is going to be let to the library.
+ * @brief Array of latency histograms of writers - recorded only by writer thread itself.
+ *
+ * Position in array is an identifier of writer.
  */
-int writer_notification = 0;
+struct latency_histograms *writers_latency;
 
 /*!
- * @brief Minimum time that reader spends in library.
+ * @brief Minimum time (in nanoseconds) that reader spends in library.
  */
-int min_reading_time = 0;
+int64_t min_reading_time = 0;
 /*!
- * @brief Maximum time that reader spends in library.
+ * @brief Maximum time (in nanoseconds) that reader spends in library.
  */
-int max_reading_time = 5;
+int64_t max_reading_time = 5 * NANOSECONDS_IN_SECOND;
 /*!
- * @brief Minimum time that writer spends in library.
+ * @brief Minimum time (in nanoseconds) that writer spends in library.
  */
-int min_writing_time = 5;
+int64_t min_writing_time = 5 * NANOSECONDS_IN_SECOND;
 /*!
- * @brief Maximum time that writer spends in library.
+ * @brief Maximum time (in nanoseconds) that writer spends in library.
  */
-int max_writing_time = 15;
+int64_t max_writing_time = 15 * NANOSECONDS_IN_SECOND;
 /*!
- * @brief Minimum time that librarian lets readers to read before he stops letting them in.
+ * @brief Minimum time (in nanoseconds) that librarian lets readers to read before he stops letting them in.
  */
-int min_allow_read_time = 10;
+int64_t min_allow_read_time = 10 * NANOSECONDS_IN_SECOND;
 /*!
- * @brief Maximum time that librarian lets readers to read before he stops letting them in.
+ * @brief Maximum time (in nanoseconds) that librarian lets readers to read before he stops letting them in.
  */
-int max_allow_read_time = 20;
+int64_t max_allow_read_time = 20 * NANOSECONDS_IN_SECOND;
 
 /*!
- * @brief Creates readers, writers and librarian threads. After that function works in endless loop and (in debug mode)
- * prints library state every second. Loop can be stopped with SIGINT signal (ctrl+c). In that case function cancels all
- * threads and frees memory allocated for variables.
+ * @brief Creates readers, writers and librarian threads - one librarian for every library (in task mode - task pool
+ * running readers and writers tasks and librarian thread). SIGINT and SIGTERM are blocked before any thread is created,
+ * so only main thread receives them. After that function blocks until signal is received (in debug mode it wakes up
+ * every second to print library state and every stats_interval seconds to print latency percentiles). Then function
+ * stops all threads, joins them, prints latency percentiles (and admissions per second in benchmark mode) and frees
+ * memory allocated for variables. In benchmark mode signal is not needed - program stops after bench_duration seconds
+ * or after ops_limit admissions.
  *
  * @param argc arguments count
  * @param argv arguments array
  * @return 0 (no error code)
  */
 int main(int argc, char* argv[]) {
-    signal(SIGINT, signal_handler);
-
     args_interpreter(argc, argv);
     variables_initializer();
 
@@ -173,298 +704,1723 @@ int main(int argc, char* argv[]) {
     int *writer_ids = malloc(writers_count * sizeof(int));
     pthread_t *readers = malloc(readers_count * sizeof(pthread_t));
     pthread_t *writers = malloc(writers_count * sizeof(pthread_t));
-    pthread_t librarian_t;
+    pthread_t *librarians = malloc(libraries_count * sizeof(pthread_t));
+    int i;
 
+    if (is_metrics_run && metrics_start(metrics_target, libraries_count, readers_count, writers_count,
+                                        readers_latency, writers_latency)) {
+        printf("Can not export metrics to %s\n", metrics_target);
+        exit(EXIT_FAILURE);
+    }
     init_queue();
+    if (lock_backend != RW_LOCK_NATIVE) {
+        for (i = 0;i < libraries_count;i++) {
+            rw_lock_init(&libraries[i].rw_lock, lock_backend, (min_allow_read_time + max_allow_read_time) / 2);
+        }
+    }
 
-    print();
+    if (is_status_logged) {
+        status_log_start(STATUS_LOG_CAPACITY);
+    }
+    print(&libraries[0]);
 
-    int i;
+    sigset_t signal_set;
+    sigemptyset(&signal_set);
+    sigaddset(&signal_set, SIGINT);
+    sigaddset(&signal_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
 
-    for (i = 0;i < readers_count;i++) {
-        reader_ids[i] = i;
-        pthread_create(&readers[i], NULL, reader, (void *) &reader_ids[i]);
+    int64_t started_at = get_timestamp();
+    trace_started_at = started_at;
+
+    if (is_task_run) {
+        start_tasks();
+    } else {
+        for (i = 0;i < readers_count;i++) {
+            reader_ids[i] = i;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            topology_pin(&attr, pin_mode, i, readers_count);
+            pthread_create(&readers[i], &attr, reader, (void *) &reader_ids[i]);
+            pthread_attr_destroy(&attr);
+        }
+        for (i = 0;i < writers_count;i++) {
+            writer_ids[i] = i;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            topology_pin(&attr, pin_mode, i, writers_count);
+            pthread_create(&writers[i], &attr, writer, (void *) &writer_ids[i]);
+            pthread_attr_destroy(&attr);
+        }
     }
-    for (i = 0;i < writers_count;i++) {
-        pthread_cond_init(&writers_conds[i], NULL);
-        writer_ids[i] = i;
-        pthread_create(&writers[i], NULL, writer, (void *) &writer_ids[i]);
+    for (i = 0;i < libraries_count && lock_backend == RW_LOCK_NATIVE;i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        topology_pin(&attr, pin_mode, i, libraries_count);
+        pthread_create(&librarians[i], &attr, librarian, (void *) &libraries[i]);
+        pthread_attr_destroy(&attr);
+    }
+
+    wait_for_signal();
+    int64_t elapsed = get_timestamp() - started_at;
+    printf("\nCleaning up...\n\n");
+
+    stop_threads();
+    if (is_task_run) {
+        task_pool_stop();
+    } else {
+        for (i = 0;i < readers_count;i++) {
+            pthread_join(readers[i], NULL);
+        }
+        for (i = 0;i < writers_count;i++) {
+            pthread_join(writers[i], NULL);
+        }
+    }
+    for (i = 0;i < libraries_count && lock_backend == RW_LOCK_NATIVE;i++) {
+        pthread_join(librarians[i], NULL);
+    }
+    if (is_status_logged) {
+        status_log_stop();
+    }
+    if (is_metrics_run) {
+        metrics_stop();
+    }
+    print_latency();
+    if (is_bench_run) {
+        print_throughput(elapsed);
+    }
+    if (is_task_run) {
+        task_pool_print_stats();
+    }
+    if (is_trace_run) {
+        trace_print_stats(&trace);
+    }
+    if (is_adaptive_run) {
+        print_read_windows();
     }
-    pthread_create(&librarian_t, NULL, librarian, NULL);
+    if (libraries_count > 1) {
+        print_libraries();
+    }
+    if (is_deadline_run) {
+        print_deadlines();
+    }
+    if (is_seqlock_run) {
+        print_seqlock();
+    }
+    for (i = 0;i < libraries_count;i++) {
+        adaptive_mutex_print_stats(&libraries[i].mutex);
+    }
+
+    cleaner();
+    free(readers);
+    free(reader_ids);
+    free(writers);
+    free(writer_ids);
+    free(librarians);
+
+    return 0;
+}
+
+/*!
+ * @brief Reports library and queues state change. Function is called with mutex locked, so it does not print anything
+ * itself. In standard mode state is pushed to status log and printed by logger thread in format:
+ * ReaderQ: readers_in_queue WriterQ: writers_in_queue [ in: R:readers_in_library W:writers_in_library ]
+ *
+ * In debug mode function does nothing - whole state is printed every second by main thread (see print_debug). In
+ * benchmark mode (and with other backends than RW_LOCK_NATIVE or with more than one library) function does nothing as
+ * well. In big-reader lock mode readers do not lock mutex, so only writers report changes (readers counts are taken
+ * from readers slots).
+ *
+ * @param library Library which state has changed
+ */
+void print(struct library *library) {
+    if (is_status_logged) {
+        status_log_push(get_readers_queue_count(library), library->writers_queue_count,
+                        get_readers_in_library_count(library), library->writers_in_library_count);
+    }
+    if (is_metrics_run) {
+        metrics_set_library((int) (library - libraries), get_readers_queue_count(library), library->writers_queue_count,
+                            get_readers_in_library_count(library), library->writers_in_library_count);
+    }
+}
+
+/*!
+ * @brief Prints library and queues state in debug mode. Function copies state with mutex locked and prints the copy
+ * after mutex is unlocked, so printing does not block readers, writers and librarian. States of readers and writers
+ * are common for all libraries, so with more than one library mutexes of all libraries are locked (in order of
+ * libraries) and every thread is printed once, in queue or in library it is visiting.
+ *
+ * Function prints all threads with theirs numbers - grouped to readers queue, writers queue and library.
+ * Format:
+ * Readers queue (seconds in queue):
+ * Reader reader_number (seconds_in_queue, with milliseconds)
+ * (...)
+ *
+ * Writers queue (seconds in queue):
+ * Writer writer_number (seconds_in_queue)
+ * (...)
+ *
+ * In library (seconds in library):
+ * Writer writer_number (seconds_in_queue) or Reader reader_number (seconds_in_queue)
+ * (...)
+ */
+void print_debug() {
+    int64_t *readers_queue_copy = malloc(readers_count * sizeof(int64_t));
+    int64_t *writers_queue_copy = malloc(writers_count * sizeof(int64_t));
+    int64_t *readers_in_library_copy = malloc(readers_count * sizeof(int64_t));
+    int64_t *writers_in_library_copy = malloc(writers_count * sizeof(int64_t));
+
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        adaptive_mutex_lock(&libraries[i].mutex);
+    }
+    for (i = 0;i < writers_count;i++) {
+        writers_queue_copy[i] = writers_state[i].queue;
+        writers_in_library_copy[i] = writers_state[i].in_library;
+    }
+    if (is_big_reader_lock) {
+        for (i = 0;i < readers_count;i++) {
+            readers_in_library_copy[i] = atomic_load(&readers_slots[i].in_library);
+            readers_queue_copy[i] = readers_in_library_copy[i] ? 0 : atomic_load(&readers_slots[i].queue);
+        }
+    } else {
+        for (i = 0;i < readers_count;i++) {
+            readers_queue_copy[i] = readers_state[i].queue;
+            readers_in_library_copy[i] = readers_state[i].in_library;
+        }
+    }
+    for (i = libraries_count - 1;i >= 0;i--) {
+        adaptive_mutex_unlock(&libraries[i].mutex);
+    }
+
+    int64_t timestamp = get_timestamp();
+    for (i = 0;i < 100;i++) {
+        printf("\n");
+    }
+    printf("Readers queue (seconds in queue):\n");
+    for (i = 0;i < readers_count;i++) {
+        if (readers_queue_copy[i] != 0) {
+            printf("Reader %i\t", i);
+            printf("(%.3f)\n", (timestamp - readers_queue_copy[i]) / (double) NANOSECONDS_IN_SECOND);
+        }
+    }
+    printf("\nWriters queue (seconds in queue):\n");
+    for (i = 0;i < writers_count;i++) {
+        if (writers_queue_copy[i] != 0) {
+            printf("Writer %i\t", i);
+            printf("(%.3f)\n", (timestamp - writers_queue_copy[i]) / (double) NANOSECONDS_IN_SECOND);
+        }
+    }
+    printf("\nIn library (seconds in library):\n");
+    for (i = 0;i < writers_count;i++) {
+        if (writers_in_library_copy[i] != 0) {
+            printf("Writer %i\t", i);
+            printf("(%.3f)\n", (timestamp - writers_in_library_copy[i]) / (double) NANOSECONDS_IN_SECOND);
+        }
+    }
+    for (i = 0;i < readers_count;i++) {
+        if (readers_in_library_copy[i] != 0) {
+            printf("Reader %i\t", i);
+            printf("(%.3f)\n", (timestamp - readers_in_library_copy[i]) / (double) NANOSECONDS_IN_SECOND);
+        }
+    }
+
+    free(readers_queue_copy);
+    free(writers_queue_copy);
+    free(readers_in_library_copy);
+    free(writers_in_library_copy);
+}
+
+/*!
+ * @brief Merges latency histograms of all readers and all writers and prints p50, p99, p999 and maximum of time spent
+ * in queue and in library for both roles. Histograms are recorded without locks, so mutex is not locked.
+ */
+void print_latency() {
+    printf("\n");
+    histogram_print_header();
+    latency_print("Readers", readers_latency, readers_count);
+    latency_print("Writers", writers_latency, writers_count);
+    printf("\n");
+}
+
+/*!
+ * @brief Prints benchmark time and number of admissions to library (and admissions per second) of readers and writers.
+ * Admissions are counted from latency histograms (every admission records time spent in queue). Then CPU time and
+ * context switches of process are printed (see throughput_print_resources).
+ *
+ * @param elapsed Benchmark time in nanoseconds
+ */
+void print_throughput(int64_t elapsed) {
+    printf("Benchmark time: %.3f s, seed: %llu\n", elapsed / (double) NANOSECONDS_IN_SECOND,
+           (unsigned long long) seed);
+    throughput_print_header();
+    throughput_print("Readers", readers_latency, readers_count, elapsed);
+    throughput_print("Writers", writers_latency, writers_count, elapsed);
+    printf("\n");
+    throughput_print_resources();
+    printf("\n");
+}
+
+/*!
+ * @brief Prints number of admissions to every library and its share of all admissions (if there is more than one
+ * library), so it can be seen how accesses are spread over libraries.
+ */
+void print_libraries() {
+    long long admissions = 0;
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        admissions += atomic_load(&libraries[i].admissions_count);
+    }
+    printf("%-24s %10s %12s\n", "Library admissions", "count", "percent");
+    for (i = 0;i < libraries_count;i++) {
+        char name[24];
+        long long count = atomic_load(&libraries[i].admissions_count);
+        snprintf(name, sizeof(name), "Library %i", i);
+        printf("%-24s %10lld %12.2f\n", name, count, admissions ? 100.0 * count / admissions : 0.0);
+    }
+    printf("\n");
+}
+
+/*!
+ * @brief Prints number of admitted visits and visits that gave up at deadline (and theirs share of all visits) of
+ * readers and writers (deadline mode). Admissions are counted from latency histograms, visits that gave up - by
+ * program or, with other backends than RW_LOCK_NATIVE, by reader-writer library (see rw_library_get_counts).
+ */
+void print_deadlines() {
+    long long timeouts[2] = {atomic_load(&readers_timeouts_count), atomic_load(&writers_timeouts_count)};
+    struct latency_histograms *latencies[2] = {readers_latency, writers_latency};
+    int counts[2] = {readers_count, writers_count};
+    const char *roles[2] = {"Readers", "Writers"};
+    printf("%-24s %10s %12s %12s\n", "Deadline visits", "admitted", "timed out", "percent");
+    int role, i;
+    struct rw_library_counts library_counts;
+    for (i = 0;i < libraries_count && lock_backend != RW_LOCK_NATIVE;i++) {
+        rw_library_get_counts(libraries[i].rw_lock.library, &library_counts);
+        timeouts[0] += library_counts.readers_gave_up;
+        timeouts[1] += library_counts.writers_gave_up;
+    }
+    for (role = 0;role < 2;role++) {
+        long long admissions = 0;
+        for (i = 0;i < counts[role];i++) {
+            admissions += (long long) histogram_count(&latencies[role][i].queue_wait);
+        }
+        printf("%-24s %10lld %12lld %12.2f\n", roles[role], admissions, timeouts[role],
+               admissions + timeouts[role] ? 100.0 * timeouts[role] / (admissions + timeouts[role]) : 0.0);
+    }
+    printf("\n");
+}
+
+/*!
+ * @brief Prints number of optimistic reads, number of theirs retries and average number of retries per read (seqlock
+ * mode). Reads are counted from latency histograms of readers.
+ */
+void print_seqlock() {
+    long long reads = 0;
+    long long retries = atomic_load(&seqlock_retries_count);
+    for (int i = 0;i < readers_count;i++) {
+        reads += (long long) histogram_count(&readers_latency[i].queue_wait);
+    }
+    printf("%-24s %10s %12s %12s\n", "Optimistic reads", "reads", "retries", "per read");
+    printf("%-24s %10lld %12lld %12.4f\n", "Readers", reads, retries, reads ? (double) retries / reads : 0.0);
+    printf("\n");
+}
+
+/*!
+ * @brief Reader threat. It works until signal_flag is reset. Function checks is writer_notification flag set - if it's
+ * not Reader enters library. If writer_notification is set, thread is waiting for signal from conditional variable
+ * readers_cond (in wake batch mode - till it is woken up, see wait_for_wake_up). Flag is checked again after every
+ * wakeup (with mutex locked), so neither spurious wakeup nor writer_notification set again before reader got mutex
+ * can let reader in while writer is in library, and broadcast sent before reader started waiting is not needed. Reader
+ * enters library (see reader_enters) in the same critical section in which it saw writer_notification reset - so
+ * librarian that sets writer_notification later finds reader already counted in library and writer waits (in
+ * write_book) till it leaves. Reader admitted but not yet counted in library could be passed by draining writer. In
+ * trace mode reader gets to queue only at arrival time of its next record (see wait_for_arrival). If there is more
+ * than one library, reader chooses library before every visit (see choose_library) and gets to its queue (see
+ * get_to_queue). In deadline mode reader that can not enter before its deadline gives up the visit (see
+ * wait_for_admission). In seqlock mode reader does not enter library at all - it reads optimistically (see
+ * read_optimistically).
+ *
+ * @param arg Reader id
+ * @return NULL
+ */
+void* reader(void* arg) {
+    int reader_id = *((int *) arg);
+    struct rng rng;
+    rng_seed(&rng, seed, reader_id);
+    if (lock_backend != RW_LOCK_NATIVE) {
+        int64_t backoff = 0;
+        while (signal_flag) {
+            read_with_lock(choose_library(&rng), reader_id, &rng, &backoff);
+        }
+        return NULL;
+    }
+    int record = is_trace_run ? trace_first(&trace, TRACE_READER, reader_id) : -1;
+    int64_t arrived_at = 0;
+    int64_t backoff = 0;
+    while (signal_flag) {
+        int64_t reading_time = is_trace_run ? wait_for_arrival(&record, &arrived_at) :
+                               rng_time(&rng, time_distribution, min_reading_time, max_reading_time);
+        if (reading_time < 0) {
+            break;
+        }
+        struct library *library = choose_library(&rng);
+        if (is_big_reader_lock) {
+            read_books_registered(library, reader_id, reading_time, arrived_at);
+            continue;
+        }
+        if (is_seqlock_run) {
+            read_optimistically(library, reader_id, reading_time, arrived_at);
+            continue;
+        }
+        adaptive_mutex_lock(&library->mutex);
+        if (is_queued_on_arrival) {
+            get_to_queue(library, TRACE_READER, reader_id, arrived_at);
+        }
+        int is_reader_admitted = 1;
+        if (wake_batch) {
+            wait_for_wake_up(library, reader_id);
+        } else {
+            is_reader_admitted = wait_for_admission(library, TRACE_READER, reader_id);
+        }
+        if (!signal_flag) {
+            adaptive_mutex_unlock(&library->mutex);
+            break;
+        }
+        if (!is_reader_admitted) {
+            adaptive_mutex_unlock(&library->mutex);
+            back_off(&backoff);
+            continue;
+        }
+        backoff = 0;
+        int64_t queue_wait = reader_enters(library, reader_id);
+        adaptive_mutex_unlock(&library->mutex);
+        read_books(library, reader_id, reading_time, queue_wait);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Writer thread. It works until signal_flag is reset. Function waits on conditional variable assigned to this
+ * thread (in *writers_state) till librarian sets its granted flag, then it waits (in write_book) till readers leave
+ * library and finally it enters library to write a book. When book is ready, writer leaving library wakes up readers
+ * (see wake_readers). In trace mode writer gets to queue only at arrival time of its next record (see
+ * wait_for_arrival). If there is more than one library, writer chooses library before every visit (see
+ * choose_library) and gets to its queue (see get_to_queue). In deadline mode writer that is not let in before its
+ * deadline gives up the visit (see wait_for_admission).
+ *
+ * @param arg Writer id
+ * @return NULL
+ */
+void* writer(void* arg) {
+    int writer_id = *((int *) arg);
+    struct rng rng;
+    rng_seed(&rng, seed, readers_count + writer_id);
+    if (lock_backend != RW_LOCK_NATIVE) {
+        int64_t backoff = 0;
+        while (signal_flag) {
+            write_with_lock(choose_library(&rng), writer_id, &rng, &backoff);
+        }
+        return NULL;
+    }
+    int record = is_trace_run ? trace_first(&trace, TRACE_WRITER, writer_id) : -1;
+    int64_t arrived_at = 0;
+    int64_t backoff = 0;
+    while (signal_flag) {
+        int64_t writing_time = is_trace_run ? wait_for_arrival(&record, &arrived_at) :
+                               rng_time(&rng, time_distribution, min_writing_time, max_writing_time);
+        if (writing_time < 0) {
+            break;
+        }
+        struct library *library = choose_library(&rng);
+        adaptive_mutex_lock(&library->mutex);
+        if (is_queued_on_arrival) {
+            get_to_queue(library, TRACE_WRITER, writer_id, arrived_at);
+        }
+        int is_writer_admitted = wait_for_admission(library, TRACE_WRITER, writer_id);
+        if (!signal_flag) {
+            adaptive_mutex_unlock(&library->mutex);
+            break;
+        }
+        if (!is_writer_admitted) {
+            adaptive_mutex_unlock(&library->mutex);
+            back_off(&backoff);
+            continue;
+        }
+        backoff = 0;
+        writers_state[writer_id].granted = 0;
+        adaptive_mutex_unlock(&library->mutex);
+        write_book(library, writer_id, writing_time);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Librarian thread. It works until signal_flag is reset. Function sleeps for some random time (default 10-20
+ * seconds, it can be changed by main function arguments) and then checks are writers in library. If there is no
+ * writers, function sets writer_notification flag, then it takes writer that waits for longest time from *writers_heap,
+ * sets its granted flag and wakes it up (see wake_writer). Then it waits on library_drained_cond till writer leaves
+ * library and starts all over again. In adaptive read window mode random time is replaced by read window adapted to
+ * writers waits (see wait_read_window and adapt_read_window). Every library has its own librarian.
+ *
+ * @param arg Library
+ * @return NULL
+ */
+void* librarian(void* arg) {
+    struct library *library = (struct library *) arg;
+    struct rng rng;
+    rng_seed(&rng, seed, readers_count + writers_count + (library - libraries));
+    while (signal_flag) {
+        if (is_adaptive_run) {
+            wait_read_window(library);
+        } else {
+            sleep_interruptible(rng_range(&rng, min_allow_read_time, max_allow_read_time));
+        }
+        if (!signal_flag) {
+            break;
+        }
+        adaptive_mutex_lock(&library->mutex);
+        if (!library->writers_in_library_count && library->writers_heap_size) {
+            library->writer_notification = 1;
+            metrics_count_phase_switch(METRICS_WRITER);
+            int writer_id = pop_longest_waiting_writer(library);
+            writers_state[writer_id].granted = 1;
+            wake_writer(writer_id);
+        }
+        while (library->writer_notification && signal_flag) {
+            pthread_cond_wait(&library->library_drained_cond, &library->mutex.mutex);
+        }
+        if (is_adaptive_run) {
+            adapt_read_window(library);
+        }
+        adaptive_mutex_unlock(&library->mutex);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Function waits till read window ends (adaptive read window mode). Every LIBRARIAN_TICK it checks library -
+ * read window lasts only while writer is waiting (readers are not cut off while there are no writers in queue), and
+ * it ends early when there are no readers in library and no reader has come since last check, so writers do not wait
+ * for empty library.
+ *
+ * @param library Library which read window is waited for (its read_window is the length of window)
+ */
+void wait_read_window(struct library *library) {
+    int64_t started_at = get_timestamp();
+    long long arrivals = atomic_load_explicit(&library->readers_arrivals_count, memory_order_relaxed);
+    while (signal_flag) {
+        sleep_interruptible(LIBRARIAN_TICK);
+        int64_t now = get_timestamp();
+        long long new_arrivals = atomic_load_explicit(&library->readers_arrivals_count, memory_order_relaxed);
+        adaptive_mutex_lock(&library->mutex);
+        int waiting_writers_count = library->writers_heap_size;
+        int readers_in_library = get_readers_in_library_count(library);
+        adaptive_mutex_unlock(&library->mutex);
+        if (!waiting_writers_count) {
+            started_at = now;
+        } else if (now - started_at >= library->read_window ||
+                   (!readers_in_library && new_arrivals == arrivals)) {
+            break;
+        }
+        arrivals = new_arrivals;
+    }
+    library->read_windows_count++;
+    library->read_windows_time += get_timestamp() - started_at;
+}
+
+/*!
+ * @brief Function adapts read window to writers queue waits (adaptive read window mode). Window is multiplied by
+ * target_writer_wait / p99 of last writers waits (ratio is limited to 0.5 - 1.25, so window changes smoothly), then
+ * it is limited to target_writer_wait / number of writers in *writers_heap and to range from LIBRARIAN_TICK to
+ * max_allow_read_time. Mutex of library has to be locked.
+ *
+ * @param library Library which read window is adapted
+ */
+void adapt_read_window(struct library *library) {
+    int64_t wait_p99 = get_recent_writer_wait_p99(library);
+    int64_t window = library->read_window;
+    if (wait_p99 > 0) {
+        double ratio = (double) target_writer_wait / (double) wait_p99;
+        ratio = ratio < 0.5 ? 0.5 : ratio > 1.25 ? 1.25 : ratio;
+        window = (int64_t) (window * ratio);
+    }
+    if (library->writers_heap_size && window > target_writer_wait / library->writers_heap_size) {
+        window = target_writer_wait / library->writers_heap_size;
+    }
+    if (window > max_allow_read_time) {
+        window = max_allow_read_time;
+    }
+    if (window < LIBRARIAN_TICK) {
+        window = LIBRARIAN_TICK;
+    }
+    library->read_window = window;
+}
+
+/*!
+ * @brief Function records writer's queue wait in writer_waits of library (adaptive read window mode). Mutex of
+ * library has to be locked.
+ *
+ * @param library Library that writer has entered
+ * @param queue_wait Time (in nanoseconds) spent by writer in queue
+ */
+void record_writer_wait(struct library *library, int64_t queue_wait) {
+    library->writer_waits[library->writer_waits_count++ % LIBRARIAN_WAITS] = queue_wait;
+}
+
+/*!
+ * @brief Function compares two queue waits (for qsort).
+ *
+ * @param first First wait
+ * @param second Second wait
+ * @return Negative number, 0 or positive number - as first wait is shorter, equal or longer than second one
+ */
+int compare_waits(const void *first, const void *second) {
+    int64_t difference = *(const int64_t *) first - *(const int64_t *) second;
+    return difference < 0 ? -1 : difference > 0;
+}
+
+/*!
+ * @brief Function computes p99 of last LIBRARIAN_WAITS writers queue waits of library. Mutex of library has to be
+ * locked.
+ *
+ * @param library Library
+ * @return p99 of writers queue waits in nanoseconds, 0 if no wait was recorded
+ */
+int64_t get_recent_writer_wait_p99(struct library *library) {
+    int count = library->writer_waits_count < LIBRARIAN_WAITS ? (int) library->writer_waits_count : LIBRARIAN_WAITS;
+    if (!count) {
+        return 0;
+    }
+    int64_t waits[LIBRARIAN_WAITS];
+    memcpy(waits, library->writer_waits, count * sizeof(int64_t));
+    qsort(waits, count, sizeof(int64_t), compare_waits);
+    return waits[(99 * count + 99) / 100 - 1];
+}
+
+/*!
+ * @brief Prints number of read windows, theirs average length, last read window and p99 of last writers queue waits
+ * of every librarian (adaptive read window mode). Librarians are stopped, so mutexes are not locked.
+ */
+void print_read_windows() {
+    printf("%-24s %10s %12s %12s %14s\n", "Read windows", "count", "avg (ms)", "last (ms)", "wait p99 (ms)");
+    for (int i = 0;i < libraries_count;i++) {
+        struct library *library = &libraries[i];
+        char name[24];
+        if (libraries_count > 1) {
+            snprintf(name, sizeof(name), "Librarian %i", i);
+        } else {
+            snprintf(name, sizeof(name), "Librarian");
+        }
+        printf("%-24s %10lld %12.3f %12.3f %14.3f\n", name, library->read_windows_count,
+               library->read_windows_count ? library->read_windows_time / (double) library->read_windows_count /
+                                             NANOSECONDS_IN_MILLISECOND : 0.0,
+               library->read_window / (double) NANOSECONDS_IN_MILLISECOND,
+               get_recent_writer_wait_p99(library) / (double) NANOSECONDS_IN_MILLISECOND);
+    }
+    printf("\n");
+}
+
+/*!
+ * @brief Function symbolises entering library by a writer and writing a book. First it waits on library_drained_cond
+ * till all readers leave library (in big-reader lock mode - till all readers slots are empty). Then writer enters
+ * library (see writer_enters), spends given time in library (see spend_time) and leaves it (see writer_leaves). Times
+ * spent in queue and in library are recorded in writer's latency histograms. Drain check is correct only because every
+ * reader is counted in library in the same critical section in which it passes admission check (reader thread and
+ * reader task call reader_enters before they unlock mutex, reader in big-reader lock mode registers in its slot before
+ * it checks writer_notification) - there is no reader that is admitted but not yet in library, so writer can not
+ * drain past it.
+ *
+ * @param library Library that writer was let in to
+ * @param writer_id Writer thread id
+ * @param writing_time Time (in nanoseconds) spent in library - random (by default 5-15 seconds, it can be changed by
+ * main function arguments) or hold time of trace record
+ */
+void write_book(struct library *library, int writer_id, int64_t writing_time) {
+    adaptive_mutex_lock( &library->mutex );
+
+    while (get_readers_in_library_count(library) && signal_flag) {
+        pthread_cond_wait(&library->library_drained_cond, &library->mutex.mutex);
+    }
+    if (!signal_flag) {
+        adaptive_mutex_unlock( &library->mutex );
+        return;
+    }
+    int64_t queue_wait = writer_enters(library, writer_id);
+
+    adaptive_mutex_unlock( &library->mutex );
+
+    histogram_record(&writers_latency[writer_id].queue_wait, queue_wait);
+    if (is_seqlock_run) {
+        seqlock_write_begin(&library->seqlock, writer_id);
+    }
+    spend_time(writing_time);
+    if (is_seqlock_run) {
+        seqlock_write_end(&library->seqlock);
+    }
+
+    adaptive_mutex_lock( &library->mutex );
+    int64_t in_library_time = writer_leaves(library, writer_id);
+    adaptive_mutex_unlock( &library->mutex );
+
+    histogram_record(&writers_latency[writer_id].in_library, in_library_time);
+}
+
+/*!
+ * @brief Function symbolises reading books by a reader that has already entered library (see reader_enters - reader
+ * enters in the same critical section in which it was admitted). Reader spends given time in library (see spend_time)
+ * and leaves it (see reader_leaves). Times spent in queue and in library are recorded in reader's latency histograms.
+ *
+ * @param library Library that reader has entered
+ * @param reader_id Reader thread id
+ * @param reading_time Time (in nanoseconds) spent in library - random (by default 0-5 seconds, it can be changed by
+ * main function arguments) or hold time of trace record
+ * @param queue_wait Time (in nanoseconds) spent by reader in queue (returned by reader_enters)
+ */
+void read_books(struct library *library, int reader_id, int64_t reading_time, int64_t queue_wait) {
+    histogram_record(&readers_latency[reader_id].queue_wait, queue_wait);
+    spend_time(reading_time);
+
+    adaptive_mutex_lock( &library->mutex );
+    int64_t in_library_time = reader_leaves(library, reader_id);
+    adaptive_mutex_unlock( &library->mutex );
+
+    histogram_record(&readers_latency[reader_id].in_library, in_library_time);
+}
+
+/*!
+ * @brief Function lets writer in to library. It sets enter library timestamp in writer's state (*writers_state in
+ * writer_id position) and resets its queue timestamp, increases writers_in_library_count and decreases
+ * writers_queue_count of library. Mutex of library has to be locked and library has to be drained.
+ *
+ * @param library Library that writer enters
+ * @param writer_id Writer id
+ * @return Time (in nanoseconds) spent by writer in queue
+ */
+int64_t writer_enters(struct library *library, int writer_id) {
+    int64_t entered_at = get_timestamp();
+    int64_t enqueued_at = writers_state[writer_id].queue;
+    writers_state[writer_id].in_library = entered_at;
+    writers_state[writer_id].queue = 0;
+    metrics_writer_queued(writer_id, 0);
+    library->writers_in_library_count++;
+    library->writers_queue_count--;
+    count_admission(library);
+    if (is_adaptive_run) {
+        record_writer_wait(library, entered_at - enqueued_at);
+    }
+
+    print(library);
+
+    return entered_at - enqueued_at;
+}
+
+/*!
+ * @brief Function lets writer out of library. It resets enter library timestamp in writer's state, decreases
+ * writers_in_library_count, sets queue timestamp, increases writers_queue_count and puts writer back to *writers_heap
+ * (if is_queued_on_arrival is set, writer gets to queue at its next arrival, see get_to_queue). Then it resets
+ * writer_notification, broadcasts library_drained_cond and wakes up readers (see wake_readers). Mutex of library has
+ * to be locked.
+ *
+ * @param library Library that writer leaves
+ * @param writer_id Writer id
+ * @return Time (in nanoseconds) spent by writer in library
+ */
+int64_t writer_leaves(struct library *library, int writer_id) {
+    int64_t left_at = get_timestamp();
+    int64_t entered_at = writers_state[writer_id].in_library;
+    writers_state[writer_id].in_library = 0;
+    library->writers_in_library_count--;
+    if (!is_queued_on_arrival) {
+        writers_state[writer_id].queue = left_at;
+        push_waiting_writer(library, writer_id);
+        library->writers_queue_count++;
+    }
+    library->writer_notification = 0;
+    metrics_count_phase_switch(METRICS_READER);
+    pthread_cond_broadcast(&library->library_drained_cond);
+    wake_readers(library, writer_id);
+
+    print(library);
+
+    return left_at - entered_at;
+}
+
+/*!
+ * @brief Function lets reader in to library. It sets enter library timestamp in reader's state (*readers_state in
+ * reader_id position) and resets its queue timestamp, increases readers_in_library_count and decreases
+ * readers_queue_count of library. Mutex of library has to be locked and writer_notification can not be set.
+ *
+ * @param library Library that reader enters
+ * @param reader_id Reader id
+ * @return Time (in nanoseconds) spent by reader in queue
+ */
+int64_t reader_enters(struct library *library, int reader_id) {
+    int64_t entered_at = get_timestamp();
+    int64_t enqueued_at = readers_state[reader_id].queue;
+    readers_state[reader_id].in_library = entered_at;
+    readers_state[reader_id].queue = 0;
+    library->readers_in_library_count++;
+    library->readers_queue_count--;
+    count_admission(library);
+    atomic_fetch_add_explicit(&library->readers_arrivals_count, 1, memory_order_relaxed);
+
+    print(library);
+
+    return entered_at - enqueued_at;
+}
+
+/*!
+ * @brief Function lets reader out of library. It resets enter library timestamp in reader's state, decreases
+ * readers_in_library_count, sets queue timestamp and increases readers_queue_count (if is_queued_on_arrival is set,
+ * reader gets to queue at its next arrival, see get_to_queue). Last reader leaving library broadcasts
+ * library_drained_cond (and in task mode submits draining_writer). Mutex of library has to be locked.
+ *
+ * @param library Library that reader leaves
+ * @param reader_id Reader id
+ * @return Time (in nanoseconds) spent by reader in library
+ */
+int64_t reader_leaves(struct library *library, int reader_id) {
+    int64_t left_at = get_timestamp();
+    int64_t entered_at = readers_state[reader_id].in_library;
+    readers_state[reader_id].in_library = 0;
+    library->readers_in_library_count--;
+    if (!is_queued_on_arrival) {
+        readers_state[reader_id].queue = left_at;
+        library->readers_queue_count++;
+    }
+    if (!library->readers_in_library_count) {
+        pthread_cond_broadcast(&library->library_drained_cond);
+        if (library->draining_writer) {
+            task_pool_submit(&library->draining_writer->task);
+            library->draining_writer = NULL;
+        }
+    }
+
+    print(library);
+
+    return left_at - entered_at;
+}
+
+/*!
+ * @brief Function wakes up writer let in by librarian - it signals conditional variable assigned to writer or, in task
+ * mode, submits writer's task if it is parked. Mutex has to be locked.
+ *
+ * @param writer_id Writer id
+ */
+void wake_writer(int writer_id) {
+    if (!is_task_run) {
+        pthread_cond_signal(&writers_state[writer_id].cond);
+        return;
+    }
+    if (writers_tasks[writer_id].parked) {
+        writers_tasks[writer_id].parked = 0;
+        task_pool_submit(&writers_tasks[writer_id].task);
+    }
+}
+
+/*!
+ * @brief Function wakes up readers waiting till writer leaves library - it broadcasts readers_cond, in wake batch mode
+ * wakes up first wake_batch readers (see wake_waiting_readers, in cohort mode readers of writer's node are woken up
+ * first) and in task mode submits all tasks from *parked_readers. Mutex of library has to be locked.
+ *
+ * @param library Library that writer leaves
+ * @param writer_id Id of writer leaving library
+ */
+void wake_readers(struct library *library, int writer_id) {
+    if (wake_batch) {
+        wake_waiting_readers(library, is_cohort_run ? topology_node_of(writer_id, writers_count) : 0);
+        return;
+    }
+    if (!is_task_run) {
+        pthread_cond_broadcast(&library->readers_cond);
+        return;
+    }
+    for (int i = 0;i < library->parked_readers_count;i++) {
+        readers_tasks[library->parked_readers[i]].parked = 0;
+        task_pool_submit(&readers_tasks[library->parked_readers[i]].task);
+    }
+    library->parked_readers_count = 0;
+}
+
+/*!
+ * @brief Function makes reader wait till writer leaves library in wake batch mode. While writer_notification is set,
+ * reader puts itself at the end of its cohort's ring of *waiting_readers and waits on its own conditional variable
+ * till it is woken up. Reader that can enter library wakes up next readers waiting (see wake_waiting_readers), so
+ * wakeups spread in batches. Mutex of library has to be locked.
+ *
+ * @param library Library that reader waits for
+ * @param reader_id Reader id
+ */
+void wait_for_wake_up(struct library *library, int reader_id) {
+    struct reader_state *state = &readers_state[reader_id];
+    int cohort = get_reader_cohort(reader_id);
+    int first, size;
+    get_cohort_ring(cohort, &first, &size);
+    if (library->writer_notification && signal_flag) {
+        metrics_count_wait(METRICS_READER);
+    }
+    while (library->writer_notification && signal_flag) {
+        int position = (library->waiting_readers_head[cohort] + library->waiting_readers_count[cohort]++) % size;
+        library->waiting_readers[first + position] = reader_id;
+        while (!state->woken && signal_flag) {
+            pthread_cond_wait(&state->cond, &library->mutex.mutex);
+        }
+        state->woken = 0;
+    }
+    if (!library->writer_notification) {
+        wake_waiting_readers(library, cohort);
+    }
+}
+
+/*!
+ * @brief Function takes up to wake_batch first readers from *waiting_readers, sets theirs woken flags and signals
+ * theirs conditional variables. Readers are taken from given cohort and, when its ring is empty, from next cohorts.
+ * Mutex of library has to be locked.
+ *
+ * @param library Library which readers are woken up
+ * @param cohort Cohort which readers are woken up first
+ */
+void wake_waiting_readers(struct library *library, int cohort) {
+    int *waiting_readers_count = library->waiting_readers_count;
+    int *waiting_readers_head = library->waiting_readers_head;
+    for (int i = 0;i < wake_batch;i++) {
+        int checked = 0;
+        while (!waiting_readers_count[cohort] && ++checked < cohorts_count) {
+            cohort = (cohort + 1) % cohorts_count;
+        }
+        if (!waiting_readers_count[cohort]) {
+            return;
+        }
+        int first, size;
+        get_cohort_ring(cohort, &first, &size);
+        struct reader_state *state = &readers_state[library->waiting_readers[first + waiting_readers_head[cohort]]];
+        waiting_readers_head[cohort] = (waiting_readers_head[cohort] + 1) % size;
+        waiting_readers_count[cohort]--;
+        state->woken = 1;
+        pthread_cond_signal(&state->cond);
+    }
+}
+
+/*!
+ * @brief Function gets reader's cohort - node of reader in cohort mode (see topology_node_of), 0 otherwise.
+ *
+ * @param reader_id Reader id
+ * @return Cohort of reader
+ */
+int get_reader_cohort(int reader_id) {
+    return is_cohort_run ? topology_node_of(reader_id, readers_count) : 0;
+}
+
+/*!
+ * @brief Function gets position and size of cohort's ring in *waiting_readers.
+ *
+ * @param cohort Cohort
+ * @param first Position of ring's beginning to set
+ * @param size Size of ring to set
+ */
+void get_cohort_ring(int cohort, int *first, int *size) {
+    *first = is_cohort_run ? topology_first_of(cohort, readers_count) : 0;
+    *size = (is_cohort_run ? topology_first_of(cohort + 1, readers_count) : readers_count) - *first;
+}
+
+/*!
+ * @brief Function waits for next arrival of reader or writer in trace mode. It sleeps till arrival time of client's
+ * record, then client gets to queue of library it has chosen (see get_to_queue). Client that has replayed all its
+ * records gets -1 - the last one sends SIGTERM to process, so program stops the same way as after Ctrl+C.
+ *
+ * @param record Position of client's next record in trace (it is moved to following record)
+ * @param arrived_at Arrival time of record to set
+ * @return Time (in nanoseconds) client spends in library, -1 if there are no more records or signal_flag is reset
+ */
+int64_t wait_for_arrival(int *record, int64_t *arrived_at) {
+    if (*record < 0) {
+        if (trace_finish(&trace)) {
+            kill(getpid(), SIGTERM);
+        }
+        return -1;
+    }
+    struct trace_record *next = &trace.records[*record];
+    *record = next->next;
+    int64_t arrival = trace_started_at + next->timestamp;
+    int64_t now = get_timestamp();
+    if (arrival > now) {
+        sleep_interruptible(arrival - now);
+    }
+    if (!signal_flag) {
+        return -1;
+    }
+    trace_count(&trace, arrival < now);
+    *arrived_at = arrival;
+    return next->hold;
+}
+
+/*!
+ * @brief Function puts client that has arrived at library to its queue (if is_queued_on_arrival is set, see
+ * writer_leaves and reader_leaves). It sets client's queue timestamp - in trace mode to arrival time of record, so late
+ * client's wait is counted from arrival, not from the moment it got to queue - and writer puts itself to
+ * *writers_heap. Mutex of library has to be locked (reader in big-reader lock mode only writes its own slot, so it
+ * does not need mutex).
+ *
+ * @param library Library that client has arrived at
+ * @param role Role of client (TRACE_READER / TRACE_WRITER)
+ * @param id Reader or writer id
+ * @param arrived_at Arrival time of trace record (0 if client has arrived now)
+ */
+void get_to_queue(struct library *library, int role, int id, int64_t arrived_at) {
+    int64_t timestamp = arrived_at ? arrived_at : get_timestamp();
+    if (role == TRACE_WRITER) {
+        writers_state[id].queue = timestamp;
+        push_waiting_writer(library, id);
+        library->writers_queue_count++;
+    } else if (is_big_reader_lock) {
+        atomic_store_explicit(&readers_slots[id].queue, timestamp, memory_order_relaxed);
+        atomic_store_explicit(&readers_slots[id].library, (int) (library - libraries), memory_order_relaxed);
+    } else {
+        readers_state[id].queue = timestamp;
+        library->readers_queue_count++;
+    }
+}
+
+/*!
+ * @brief Function checks if client may go on - writer when librarian has let it in (set its granted flag), reader when
+ * writer_notification is not set. Mutex of library has to be locked.
+ *
+ * @param library Library
+ * @param role Role of client (TRACE_READER / TRACE_WRITER)
+ * @param id Reader or writer id
+ * @return 1 if client may go on, 0 if it has to wait
+ */
+int is_admitted(struct library *library, int role, int id) {
+    return role == TRACE_WRITER ? writers_state[id].granted : !library->writer_notification;
+}
+
+/*!
+ * @brief Function waits till client may go on (see is_admitted) or signal_flag is reset - writer on its conditional
+ * variable, reader on readers_cond. Condition is checked again after every wakeup. In deadline mode client waits till
+ * deadline - its queue timestamp + deadline_time, measured with monotonic clock like conditional variables - and then
+ * it gives up (see give_up). Mutex of library has to be locked.
+ *
+ * @param library Library which queue client waits in
+ * @param role Role of client (TRACE_READER / TRACE_WRITER)
+ * @param id Reader or writer id
+ * @return 1 if client may go on, 0 if it gave up (or signal_flag was reset)
+ */
+int wait_for_admission(struct library *library, int role, int id) {
+    pthread_cond_t *cond = role == TRACE_WRITER ? &writers_state[id].cond : &library->readers_cond;
+    int64_t deadline = (role == TRACE_WRITER ? writers_state[id].queue : readers_state[id].queue) + deadline_time;
+    struct timespec deadline_time_spec = {deadline / NANOSECONDS_IN_SECOND, deadline % NANOSECONDS_IN_SECOND};
+    if (!is_admitted(library, role, id) && signal_flag) {
+        metrics_count_wait(role == TRACE_WRITER ? METRICS_WRITER : METRICS_READER);
+    }
+    while (!is_admitted(library, role, id) && signal_flag) {
+        if (!is_deadline_run) {
+            pthread_cond_wait(cond, &library->mutex.mutex);
+        } else if (get_timestamp() >= deadline ||
+                   pthread_cond_timedwait(cond, &library->mutex.mutex, &deadline_time_spec) == ETIMEDOUT) {
+            if (!is_admitted(library, role, id)) {
+                give_up(library, role, id);
+                return 0;
+            }
+        }
+    }
+    return is_admitted(library, role, id);
+}
+
+/*!
+ * @brief Function delays next arrival of client that gave up its visit at deadline (deadline mode), so it does not get
+ * back to queue at once and lock mutex of library again and again for whole phase it can not enter in (with deadline
+ * 0 it would give up at once every time). Client sleeps DEADLINE_BACKOFF_TIME, doubled with every next visit given up
+ * in a row, up to DEADLINE_MAX_BACKOFF_TIME - backoff is reset to 0 by caller when client is admitted. In trace mode
+ * arrivals are given by trace, so function does nothing.
+ *
+ * @param backoff Last backoff time of client in nanoseconds (0 if its last visit was admitted), updated by function
+ */
+void back_off(int64_t *backoff) {
+    if (is_trace_run) {
+        return;
+    }
+    *backoff = *backoff ? *backoff * 2 : DEADLINE_BACKOFF_TIME;
+    if (*backoff > DEADLINE_MAX_BACKOFF_TIME) {
+        *backoff = DEADLINE_MAX_BACKOFF_TIME;
+    }
+    sleep_interruptible(*backoff);
+}
+
+/*!
+ * @brief Function takes client whose deadline passed off from queue of library (deadline mode) - it resets client's
+ * queue timestamp and decreases queue counter, writer is also taken off from *writers_heap (see
+ * remove_waiting_writer). Mutex of library has to be locked.
+ *
+ * @param library Library which queue client leaves
+ * @param role Role of client (TRACE_READER / TRACE_WRITER)
+ * @param id Reader or writer id
+ */
+void give_up(struct library *library, int role, int id) {
+    if (role == TRACE_WRITER) {
+        remove_waiting_writer(library, id);
+        writers_state[id].queue = 0;
+        metrics_writer_queued(id, 0);
+        library->writers_queue_count--;
+        atomic_fetch_add_explicit(&writers_timeouts_count, 1, memory_order_relaxed);
+    } else {
+        readers_state[id].queue = 0;
+        library->readers_queue_count--;
+        atomic_fetch_add_explicit(&readers_timeouts_count, 1, memory_order_relaxed);
+    }
+    print(library);
+}
+
+/*!
+ * @brief Function symbolises optimistic reading of library's book (seqlock mode). Reader takes sequence snapshot,
+ * copies the book and spends given time reading it (see spend_time), then checks sequence again - if writer was
+ * writing in the meantime, reading is retried. Reader does not lock mutex, does not look at writer_notification and
+ * does not write anything shared (only number of retries, and only if there were any), so read window of librarian
+ * does not hold writers back for it. Time from arrival to start of successful reading is recorded as queue wait and
+ * time of successful reading as time spent in library.
+ *
+ * @param library Library which book is read
+ * @param reader_id Reader thread id
+ * @param reading_time Time (in nanoseconds) of reading - random or hold time of trace record
+ * @param arrived_at Arrival time of trace record (0 if reader has arrived now)
+ */
+void read_optimistically(struct library *library, int reader_id, int64_t reading_time, int64_t arrived_at) {
+    long long book[SEQLOCK_BOOK_WORDS];
+    int64_t arrival = arrived_at ? arrived_at : get_timestamp();
+    int64_t read_at;
+    long long retries = -1;
+    unsigned int sequence;
+    do {
+        retries++;
+        wait_for_writing(library);
+        sequence = seqlock_read_begin(&library->seqlock);
+        read_at = get_timestamp();
+        seqlock_read_book(&library->seqlock, book);
+        spend_time(reading_time);
+    } while (signal_flag && seqlock_read_retry(&library->seqlock, sequence));
+    if (!signal_flag) {
+        return;
+    }
+    if (retries) {
+        atomic_fetch_add_explicit(&seqlock_retries_count, retries, memory_order_relaxed);
+    }
+    histogram_record(&readers_latency[reader_id].queue_wait, read_at - arrival);
+    histogram_record(&readers_latency[reader_id].in_library, get_timestamp() - read_at);
+    count_admission(library);
+}
 
-    if (is_debug_run) {
-        while (signal_flag) {
-            sleep(1);
-            pthread_mutex_lock(&mutex);
-            print();
-            pthread_mutex_unlock(&mutex);
+/*!
+ * @brief Function waits till no writer is writing the book of library (sequence is even) or signal_flag is reset. In
+ * benchmark mode it yields processor between checks, in standard mode it sleeps SEQLOCK_BACKOFF_TIME (writers write
+ * for seconds there).
+ *
+ * @param library Library which book is read
+ */
+void wait_for_writing(struct library *library) {
+    while (signal_flag && (seqlock_read_begin(&library->seqlock) & 1)) {
+        if (is_bench_run) {
+            sched_yield();
+        } else {
+            sleep_interruptible(SEQLOCK_BACKOFF_TIME);
         }
-    } else {
-        while (signal_flag);
     }
-    printf("\nCleaning up...\n\n");
+}
 
-    for (i = 0;i < readers_count;i++) {
-        pthread_cancel(readers[i]);
+/*!
+ * @brief Function chooses library for next visit of reader or writer - uniformly or from Zipf distribution (see
+ * libraries_weights). If there is only one library, no random number is drawn, so times drawn with given seed do not
+ * change.
+ *
+ * @param rng Random number generator of reader or writer
+ * @return Library
+ */
+struct library* choose_library(struct rng *rng) {
+    if (libraries_count == 1) {
+        return &libraries[0];
     }
-    for (i = 0;i < writers_count;i++) {
-        pthread_cancel(writers[i]);
+    if (libraries_weights) {
+        return &libraries[rng_pick(rng, libraries_weights, libraries_count)];
     }
-    pthread_cancel(librarian_t);
-
-    cleaner();
-    free(readers);
-    free(reader_ids);
-    free(writers);
-    free(writer_ids);
+    return &libraries[rng_below(rng, libraries_count)];
+}
 
-    return 0;
+/*!
+ * @brief Function allocates readers and writers tasks and starts task pool (task mode). Readers tasks are submitted at
+ * once, writers tasks are parked till librarian lets them in.
+ */
+void start_tasks() {
+    readers_tasks = malloc(readers_count * sizeof(struct client_task));
+    writers_tasks = malloc(writers_count * sizeof(struct client_task));
+    int i;
+    for (i = 0;i < writers_count;i++) {
+        writers_tasks[i].task.run = run_writer_task;
+        writers_tasks[i].id = i;
+        writers_tasks[i].step = CLIENT_WAITING;
+        writers_tasks[i].parked = 1;
+        rng_seed(&writers_tasks[i].rng, seed, readers_count + i);
+    }
+    task_pool_start(task_workers, readers_count + writers_count, pin_mode);
+    for (i = 0;i < readers_count;i++) {
+        readers_tasks[i].task.run = run_reader_task;
+        readers_tasks[i].id = i;
+        readers_tasks[i].step = CLIENT_WAITING;
+        readers_tasks[i].parked = 0;
+        rng_seed(&readers_tasks[i].rng, seed, i);
+        task_pool_submit(&readers_tasks[i].task);
+    }
 }
 
 /*!
- * @brief Prints library and queues state. There are two different of printing - one standard and one for debug mode.
- *
- * In standard mode function prints message in format:
- * ReaderQ: readers_in_queue WriterQ: writers_in_queue [ in: R:readers_in_library W:writers_in_library ]
- *
- * In debug mode function prints all threads with theirs numbers - grouped to readers queue, writers queue and library.
- * Format:
- * Readers queue (seconds in queue):
- * Reader reader_number (seconds_in_queue)
- * (...)
- *
- * Writers queue (seconds in queue):
- * Writer writer_number (seconds_in_queue)
- * (...)
+ * @brief Reader task step (task mode). It works like reader thread, but it never blocks worker thread: reader whose
+ * time in library passed leaves library, then it enters library again or - if writer_notification is set - it is
+ * parked in *parked_readers till writer leaves library (see wake_readers). Time in library is spent in timers heap of
+ * task pool (in benchmark mode worker spins and task is submitted again after leaving, so other tasks can run). Task
+ * mode works with one library only.
  *
- * In library (seconds in library):
- * Writer writer_number (seconds_in_queue) or Reader reader_number (seconds_in_queue)
- * (...)
+ * @param task Reader task
  */
-void print() {
-    if (is_debug_run == 0) {
-        printf("ReaderQ: %i\t", readers_queue_count);
-        printf("WriterQ: %i\t", writers_queue_count);
-        printf("[ in: R:%i\t", readers_in_library_count);
-        printf("W:%i ]\n", writers_in_library_count);
-    } else {
-        int i;
-        for (i = 0;i < 100;i++) {
-            printf("\n");
-        }
-        printf("Readers queue (seconds in queue):\n");
-        for (i = 0;i < readers_count;i++) {
-            if (readers_queue[i] != 0) {
-                printf("Reader %i\t", i);
-                printf("(%li)\n", get_timestamp() - readers_queue[i]);
+void run_reader_task(struct task *task) {
+    struct client_task *client = (struct client_task *) task;
+    int reader_id = client->id;
+    struct library *library = &libraries[0];
+    adaptive_mutex_lock(&library->mutex);
+    while (signal_flag) {
+        if (client->step == CLIENT_IN_LIBRARY) {
+            int64_t in_library_time = reader_leaves(library, reader_id);
+            client->step = CLIENT_WAITING;
+            adaptive_mutex_unlock(&library->mutex);
+            histogram_record(&readers_latency[reader_id].in_library, in_library_time);
+            if (is_bench_run) {
+                task_pool_submit(task);
+                return;
             }
+            adaptive_mutex_lock(&library->mutex);
+            continue;
         }
-        printf("\nWriters queue (seconds in queue):\n");
-        for (i = 0;i < writers_count;i++) {
-            if (writers_queue[i] != 0) {
-                printf("Writer %i\t", i);
-                printf("(%li)\n", get_timestamp() - writers_queue[i]);
-            }
-        }
-        printf("\nIn library (seconds in library):\n");
-        for (i = 0;i < writers_count;i++) {
-            if (writers_in_library[i] != 0) {
-                printf("Writer %i\t", i);
-                printf("(%li)\n", get_timestamp() - writers_in_library[i]);
-            }
+        if (library->writer_notification) {
+            client->parked = 1;
+            metrics_count_wait(METRICS_READER);
+            library->parked_readers[library->parked_readers_count++] = reader_id;
+            break;
         }
-        for (i = 0;i < readers_count;i++) {
-            if (readers_in_library[i] != 0) {
-                printf("Reader %i\t", i);
-                printf("(%li)\n", get_timestamp() - readers_in_library[i]);
-            }
+        int64_t queue_wait = reader_enters(library, reader_id);
+        client->step = CLIENT_IN_LIBRARY;
+        adaptive_mutex_unlock(&library->mutex);
+        histogram_record(&readers_latency[reader_id].queue_wait, queue_wait);
+        int64_t duration = rng_time(&client->rng, time_distribution, min_reading_time, max_reading_time);
+        if (!is_bench_run) {
+            task_pool_submit_at(task, get_timestamp() + duration);
+            return;
         }
+        spend_time(duration);
+        adaptive_mutex_lock(&library->mutex);
     }
+    adaptive_mutex_unlock(&library->mutex);
 }
 
 /*!
- * @brief Reader threat. It works in endless loop. Function checks is writer_notification flag set - if it's not
- * Reader enters library. If writer_notification is set, thread is waiting for signal from conditional variable
- * readers_cond.
+ * @brief Writer task step (task mode). It works like writer thread, but it never blocks worker thread: writer whose
+ * time in library passed leaves library, writer that is not let in by librarian yet is parked till librarian wakes it
+ * up (see wake_writer) and writer let in is parked as draining_writer till last reader leaves library (see
+ * reader_leaves). Time in library is spent in timers heap of task pool (in benchmark mode worker spins). Task mode
+ * works with one library only.
  *
- * @param arg Reader id
+ * @param task Writer task
  */
-void* reader(void* arg) {
-    int reader_id = *((int *) arg);
-    while (1) {
-        pthread_mutex_lock(&mutex);
-        if (writer_notification) {
-            pthread_cond_wait(&readers_cond, &mutex);
+void run_writer_task(struct task *task) {
+    struct client_task *client = (struct client_task *) task;
+    int writer_id = client->id;
+    struct library *library = &libraries[0];
+    adaptive_mutex_lock(&library->mutex);
+    while (signal_flag) {
+        if (client->step == CLIENT_IN_LIBRARY) {
+            int64_t in_library_time = writer_leaves(library, writer_id);
+            client->step = CLIENT_WAITING;
+            adaptive_mutex_unlock(&library->mutex);
+            histogram_record(&writers_latency[writer_id].in_library, in_library_time);
+            adaptive_mutex_lock(&library->mutex);
+            continue;
+        }
+        if (client->step == CLIENT_WAITING) {
+            if (!writers_state[writer_id].granted) {
+                client->parked = 1;
+                metrics_count_wait(METRICS_WRITER);
+                break;
+            }
+            writers_state[writer_id].granted = 0;
+            client->step = CLIENT_DRAINING;
+        }
+        if (library->readers_in_library_count) {
+            library->draining_writer = client;
+            break;
         }
-        pthread_mutex_unlock(&mutex);
-        read_books(reader_id);
+        int64_t queue_wait = writer_enters(library, writer_id);
+        client->step = CLIENT_IN_LIBRARY;
+        adaptive_mutex_unlock(&library->mutex);
+        histogram_record(&writers_latency[writer_id].queue_wait, queue_wait);
+        int64_t duration = rng_time(&client->rng, time_distribution, min_writing_time, max_writing_time);
+        if (!is_bench_run) {
+            task_pool_submit_at(task, get_timestamp() + duration);
+            return;
+        }
+        spend_time(duration);
+        adaptive_mutex_lock(&library->mutex);
     }
+    adaptive_mutex_unlock(&library->mutex);
 }
 
 /*!
- * @brief Writer thread. It works in endless loop. Function waits for signal from conditional variable assigned to this
- * thread (array *writers_cond), then it waits till readers leave library and finally it enters library to write a book.
- * When book is ready (writer left library) function sends signal to readers conditional variable (readers_cond).
+ * @brief Function symbolises reading books by a reader in big-reader lock mode. Reader registers in its slot (sets
+ * enter library timestamp) and then checks writer_notification - both with sequentially consistent atomics, so either
+ * reader sees the flag or writer sweeping slots sees the reader. If writer_notification is set, reader clears its slot,
+ * wakes up writer draining library and waits on readers_cond till writer leaves, then it tries again. Leaving library
+ * is one store to reader's slot - only if writer is waiting, reader locks mutex to broadcast library_drained_cond.
+ * If is_queued_on_arrival is set, reader gets to queue of library first (see get_to_queue).
  *
- * @param arg Writer id
+ * @param library Library that reader enters
+ * @param reader_id Reader thread id
+ * @param reading_time Time (in nanoseconds) spent in library
+ * @param arrived_at Arrival time of trace record (0 if reader has arrived now)
  */
-void* writer(void* arg) {
-    int writer_id = *((int *) arg);
+void read_books_registered(struct library *library, int reader_id, int64_t reading_time, int64_t arrived_at) {
+    struct reader_slot *slot = &readers_slots[reader_id];
+    if (is_queued_on_arrival) {
+        get_to_queue(library, TRACE_READER, reader_id, arrived_at);
+    }
+    int64_t entered_at;
     while (1) {
-        pthread_mutex_lock(&mutex);
-        pthread_cond_wait(&writers_conds[writer_id], &mutex);
-        pthread_mutex_unlock(&mutex);
-        while (readers_in_library_count);
-        write_book(writer_id);
-        pthread_cond_broadcast(&readers_cond);
+        entered_at = get_timestamp();
+        atomic_store(&slot->in_library, entered_at);
+        if (!atomic_load(&library->writer_notification)) {
+            break;
+        }
+        atomic_store(&slot->in_library, 0);
+        metrics_count_wait(METRICS_READER);
+        adaptive_mutex_lock(&library->mutex);
+        pthread_cond_broadcast(&library->library_drained_cond);
+        while (library->writer_notification && signal_flag) {
+            pthread_cond_wait(&library->readers_cond, &library->mutex.mutex);
+        }
+        adaptive_mutex_unlock(&library->mutex);
+        if (!signal_flag) {
+            return;
+        }
+    }
+    count_admission(library);
+    atomic_fetch_add_explicit(&library->readers_arrivals_count, 1, memory_order_relaxed);
+    histogram_record(&readers_latency[reader_id].queue_wait,
+                     entered_at - atomic_load_explicit(&slot->queue, memory_order_relaxed));
+
+    spend_time(reading_time);
+
+    int64_t left_at = get_timestamp();
+    atomic_store_explicit(&slot->queue, is_queued_on_arrival ? 0 : left_at, memory_order_relaxed);
+    atomic_store(&slot->in_library, 0);
+    if (atomic_load(&library->writer_notification)) {
+        adaptive_mutex_lock(&library->mutex);
+        pthread_cond_broadcast(&library->library_drained_cond);
+        adaptive_mutex_unlock(&library->mutex);
     }
+    histogram_record(&readers_latency[reader_id].in_library, left_at - entered_at);
 }
 
 /*!
- * @brief Librarian thread. It works in endless loop. Function sleeps for some random time (default 10-20 seconds, it
- * can be changed by main function arguments) and then checks are writers in library. If there is no writers, function
- * sets writer_notification flag, then it looks for writer that waits for longest time and sends signal to conditional
- * variable assigned to this writer id. Then it waits till writers leave library and starts all over again.
+ * @brief Function returns number of readers in library. In big-reader lock mode it sweeps all readers slots (it takes
+ * O(N) time, but it is called only by writers and by print) - with more than one library only readers registered in
+ * given library are counted (reader sets its library before it registers, so reader that is in library is never
+ * missed). Otherwise it returns readers_in_library_count (mutex of library has to be locked).
+ *
+ * @param library Library
+ * @return Number of readers in library
  */
-void* librarian() {
-    while (1) {
-        sleep(get_random(min_allow_read_time, max_allow_read_time));
-        if (!writers_in_library_count) {
-            writer_notification = 1;
-            int i, time, max_waiter_id = 0, max_time = 0;
-            for (i = 0;i < writers_count;i++) {
-                time = get_timestamp() - writers_queue[i];
-                if (time > max_time) {
-                    max_time = time;
-                    max_waiter_id = i;
-                }
-            }
-            pthread_cond_signal(&writers_conds[max_waiter_id]);
+int get_readers_in_library_count(struct library *library) {
+    if (!is_big_reader_lock) {
+        return library->readers_in_library_count;
+    }
+    int library_number = (int) (library - libraries);
+    int count = 0;
+    for (int i = 0;i < readers_count;i++) {
+        if (atomic_load(&readers_slots[i].in_library) &&
+            (libraries_count == 1 || atomic_load(&readers_slots[i].library) == library_number)) {
+            count++;
         }
-        while (writers_in_library_count);
     }
+    return count;
 }
 
 /*!
- * @brief Function symbolises entering library by a writer and writing a book. It sets enter library timestamp in array
- * *writers_in_library (in writer_id position). Then function resets corresponding timestamp in array *writers_queue,
- * increases writers_in_library_count and decreases writers_queue_count. After that function sleeps for some random time
- * (by default 5-15 seconds, it can be changed by main function arguments) and leaves library (sets timestamp in
- * *writers_queue, resets timestamp in *writers_in_library array, increases writers_queue_count and decreases
- * writers_in_library_count).
+ * @brief Function returns number of readers waiting in queue of library. In big-reader lock mode readers do not count
+ * themselves, so it sweeps all readers slots like get_readers_in_library_count (reader is waiting when it has queue
+ * timestamp and is not in library). Otherwise it returns readers_queue_count (mutex of library has to be locked).
  *
- * @param writer_id Writer thread id
+ * @param library Library
+ * @return Number of readers in queue
  */
-void write_book(int writer_id) {
-    pthread_mutex_lock( &mutex );
-
-    writers_in_library[writer_id] = get_timestamp();
-    writers_queue[writer_id] = 0;
-    writers_in_library_count++;
-    writers_queue_count--;
-
-    print();
-
-    pthread_mutex_unlock( &mutex );
-
-    sleep(get_random(min_writing_time, max_writing_time));
-
-    pthread_mutex_lock( &mutex );
-
-    writers_in_library[writer_id] = 0;
-    writers_queue[writer_id] = get_timestamp();
-    writers_in_library_count--;
-    writers_queue_count++;
-    writer_notification = 0;
-
-    print();
-
-    pthread_mutex_unlock( &mutex );
+int get_readers_queue_count(struct library *library) {
+    if (!is_big_reader_lock) {
+        return library->readers_queue_count;
+    }
+    int library_number = (int) (library - libraries);
+    int count = 0;
+    for (int i = 0;i < readers_count;i++) {
+        if (!atomic_load(&readers_slots[i].in_library) && atomic_load(&readers_slots[i].queue) &&
+            (libraries_count == 1 || atomic_load(&readers_slots[i].library) == library_number)) {
+            count++;
+        }
+    }
+    return count;
 }
 
 /*!
- * @brief Function symbolises entering library by a reader and reading books. It sets enter library timestamp in array
- * *readers_in_library (in reader_id position). Then function resets corresponding timestamp in array *readers_queue,
- * increases readers_in_library_count and decreases readers_queue_count. After that function sleeps for some random time
- * (by default 0-5 seconds, it can be changed by main function arguments) and leaves library (sets timestamp in
- * *readers_queue, resets timestamp in *readers_in_library array, increases readers_queue_count and decreases
- * readers_in_library_count).
+ * @brief Function symbolises reading books by a reader when lock_backend is not RW_LOCK_NATIVE. Reader locks rw_lock
+ * for reading (in deadline mode only before its deadline - if it gives up, it backs off before next visit), spends some
+ * random time in library and unlocks it. Time spent waiting for lock and holding it is recorded in reader's
+ * latency histograms. Library state is not kept, so nothing is printed.
  *
+ * @param library Library which rw_lock is locked
  * @param reader_id Reader thread id
+ * @param rng Random number generator of reader thread
+ * @param backoff Backoff time of reader after its last visit (deadline mode, see back_off)
  */
-void read_books(int reader_id) {
-    pthread_mutex_lock( &mutex );
+void read_with_lock(struct library *library, int reader_id, struct rng *rng, int64_t *backoff) {
+    int64_t enqueued_at = get_timestamp();
+    int64_t deadline = enqueued_at + deadline_time;
+    struct timespec deadline_time_spec = {deadline / NANOSECONDS_IN_SECOND, deadline % NANOSECONDS_IN_SECOND};
+    int result = !is_deadline_run ? rw_lock_read_lock(&library->rw_lock) :
+                 rw_lock_timed_read_lock(&library->rw_lock, deadline_time ? &deadline_time_spec : NULL);
+    if (result) {
+        if (result != ECANCELED) {
+            back_off(backoff);
+        }
+        return;
+    }
+    *backoff = 0;
+    int64_t entered_at = get_timestamp();
+    count_admission(library);
+    spend_time(rng_time(rng, time_distribution, min_reading_time, max_reading_time));
+    int64_t left_at = get_timestamp();
+    rw_lock_read_unlock(&library->rw_lock);
+    histogram_record(&readers_latency[reader_id].queue_wait, entered_at - enqueued_at);
+    histogram_record(&readers_latency[reader_id].in_library, left_at - entered_at);
+}
 
-    readers_in_library[reader_id] = get_timestamp();
-    readers_queue[reader_id] = 0;
-    readers_in_library_count++;
-    readers_queue_count--;
+/*!
+ * @brief Function symbolises writing a book by a writer when lock_backend is not RW_LOCK_NATIVE. Writer locks rw_lock
+ * for writing (in deadline mode only before its deadline - if it gives up, it backs off before next visit), spends some
+ * random time in library and unlocks it. Time spent waiting for lock and holding it is recorded in writer's
+ * latency histograms. Library state is not kept, so nothing is printed.
+ *
+ * @param library Library which rw_lock is locked
+ * @param writer_id Writer thread id
+ * @param rng Random number generator of writer thread
+ * @param backoff Backoff time of writer after its last visit (deadline mode, see back_off)
+ */
+void write_with_lock(struct library *library, int writer_id, struct rng *rng, int64_t *backoff) {
+    int64_t enqueued_at = get_timestamp();
+    int64_t deadline = enqueued_at + deadline_time;
+    struct timespec deadline_time_spec = {deadline / NANOSECONDS_IN_SECOND, deadline % NANOSECONDS_IN_SECOND};
+    int result = !is_deadline_run ? rw_lock_write_lock(&library->rw_lock) :
+                 rw_lock_timed_write_lock(&library->rw_lock, deadline_time ? &deadline_time_spec : NULL);
+    if (result) {
+        if (result != ECANCELED) {
+            back_off(backoff);
+        }
+        return;
+    }
+    *backoff = 0;
+    int64_t entered_at = get_timestamp();
+    count_admission(library);
+    spend_time(rng_time(rng, time_distribution, min_writing_time, max_writing_time));
+    int64_t left_at = get_timestamp();
+    rw_lock_write_unlock(&library->rw_lock);
+    histogram_record(&writers_latency[writer_id].queue_wait, entered_at - enqueued_at);
+    histogram_record(&writers_latency[writer_id].in_library, left_at - entered_at);
+}
 
-    print();
+/*!
+ * @brief Function initialises queue timestamps of readers and writers with actual timestamp and puts all readers and
+ * writers to queue of the first library (writers to its *writers_heap). If is_queued_on_arrival is set, readers and
+ * writers get to queue at theirs arrivals, so queue timestamps are reset.
+ */
+void init_queue() {
+    int i;
+    int64_t timestamp = is_queued_on_arrival ? 0 : get_timestamp();
+    for (i = 0;i < readers_count;i++) {
+        readers_state[i].queue = timestamp;
+        if (is_big_reader_lock) {
+            atomic_init(&readers_slots[i].in_library, 0);
+            atomic_init(&readers_slots[i].queue, timestamp);
+            atomic_init(&readers_slots[i].library, 0);
+        }
+    }
+    for (i = 0;i < writers_count;i++) {
+        writers_state[i].queue = timestamp;
+        if (!is_queued_on_arrival) {
+            push_waiting_writer(&libraries[0], i);
+        }
+    }
+    if (!is_queued_on_arrival) {
+        libraries[0].readers_queue_count = is_seqlock_run ? 0 : readers_count;
+        libraries[0].writers_queue_count = writers_count;
+    }
+}
 
-    pthread_mutex_unlock( &mutex );
+/*!
+ * @brief Function gives writer next ticket and puts it to *writers_heap (see sift_writer_up). It takes
+ * O(log N) time. Mutex of library has to be locked.
+ *
+ * @param library Library which *writers_heap writer gets to
+ * @param writer_id Writer thread id
+ */
+void push_waiting_writer(struct library *library, int writer_id) {
+    writers_state[writer_id].ticket = library->next_writer_ticket++;
+    metrics_writer_queued(writer_id, writers_state[writer_id].queue);
+    sift_writer_up(library, library->writers_heap_size++, writer_id);
+}
 
-    sleep(get_random(min_reading_time, max_reading_time));
+/*!
+ * @brief Function takes writer that waits for longest time (with the lowest ticket) from *writers_heap and restores
+ * heap order (see remove_waiting_writer). It takes O(log N) time. Mutex of library has to be locked and heap can not be
+ * empty.
+ *
+ * @param library Library which *writers_heap writer is taken from
+ * @return Writer thread id
+ */
+int pop_longest_waiting_writer(struct library *library) {
+    int longest_waiting_writer = library->writers_heap[0];
+    remove_waiting_writer(library, longest_waiting_writer);
+    return longest_waiting_writer;
+}
 
-    pthread_mutex_lock( &mutex );
+/*!
+ * @brief Function takes writer off from *writers_heap - from any position, which is found by writer's heap_position
+ * (so heap is not searched) - and restores heap order (last writer is put at freed position and sifted up or down).
+ * It takes O(log N) time. Mutex of library has to be locked and writer has to be in heap.
+ *
+ * @param library Library which *writers_heap writer is taken from
+ * @param writer_id Writer thread id
+ */
+void remove_waiting_writer(struct library *library, int writer_id) {
+    int position = writers_state[writer_id].heap_position;
+    int last_writer = library->writers_heap[--library->writers_heap_size];
+    if (last_writer == writer_id) {
+        return;
+    }
+    if (position > 0 &&
+        writers_state[library->writers_heap[(position - 1) / 2]].ticket > writers_state[last_writer].ticket) {
+        sift_writer_up(library, position, last_writer);
+    } else {
+        sift_writer_down(library, position, last_writer);
+    }
+}
 
-    readers_in_library[reader_id] = 0;
-    readers_queue[reader_id] = get_timestamp();
-    readers_in_library_count--;
-    readers_queue_count++;
+/*!
+ * @brief Function puts writer at free position of *writers_heap and moves it up (towards position 0) till its parent
+ * has lower ticket. Heap positions of all moved writers are updated. Mutex of library has to be locked.
+ *
+ * @param library Library which *writers_heap writer is put to
+ * @param position Free position in heap
+ * @param writer_id Writer thread id
+ */
+void sift_writer_up(struct library *library, int position, int writer_id) {
+    int *writers_heap = library->writers_heap;
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (writers_state[writers_heap[parent]].ticket <= writers_state[writer_id].ticket) {
+            break;
+        }
+        writers_heap[position] = writers_heap[parent];
+        writers_state[writers_heap[position]].heap_position = position;
+        position = parent;
+    }
+    writers_heap[position] = writer_id;
+    writers_state[writer_id].heap_position = position;
+}
 
-    print();
+/*!
+ * @brief Function puts writer at free position of *writers_heap and moves it down till both its children have higher
+ * tickets. Heap positions of all moved writers are updated. Mutex of library has to be locked.
+ *
+ * @param library Library which *writers_heap writer is put to
+ * @param position Free position in heap
+ * @param writer_id Writer thread id
+ */
+void sift_writer_down(struct library *library, int position, int writer_id) {
+    int *writers_heap = library->writers_heap;
+    int writers_heap_size = library->writers_heap_size;
+    while (1) {
+        int child = 2 * position + 1;
+        if (child >= writers_heap_size) {
+            break;
+        }
+        if (child + 1 < writers_heap_size &&
+            writers_state[writers_heap[child + 1]].ticket < writers_state[writers_heap[child]].ticket) {
+            child++;
+        }
+        if (writers_state[writer_id].ticket <= writers_state[writers_heap[child]].ticket) {
+            break;
+        }
+        writers_heap[position] = writers_heap[child];
+        writers_state[writers_heap[position]].heap_position = position;
+        position = child;
+    }
+    writers_heap[position] = writer_id;
+    writers_state[writer_id].heap_position = position;
+}
 
-    pthread_mutex_unlock( &mutex );
+/*!
+ * @brief Function symbolises time spent in library. In benchmark mode it spins (reading monotonic clock) for given
+ * time, so throughput is limited only by synchronization and not by sleep granularity - 0 means no work at all. In
+ * standard mode it sleeps (see sleep_interruptible).
+ *
+ * @param duration Time in nanoseconds
+ */
+void spend_time(int64_t duration) {
+    if (!is_bench_run) {
+        sleep_interruptible(duration);
+        return;
+    }
+    if (duration) {
+        int64_t deadline = get_timestamp() + duration;
+        while (signal_flag && get_timestamp() < deadline) {
+            continue;
+        }
+    }
 }
 
 /*!
- * @brief Function initialises writers_queue and readers_queue with actual timestamp.
+ * @brief Function counts admission to library if ops_limit is set (atomically, so it does not need mutex and can be
+ * used by every backend). When ops_limit is reached, SIGTERM is sent to process, so main thread stops program the same
+ * way as after Ctrl+C. If there is more than one library, admission is counted in library too (see print_libraries).
+ *
+ * @param library Library that reader or writer enters
  */
-void init_queue() {
-    int i;
-    time_t timestamp = get_timestamp();
-    for (i = 0;i < readers_count;i++) {
-        readers_queue[i] = timestamp;
+void count_admission(struct library *library) {
+    if (libraries_count > 1) {
+        atomic_fetch_add_explicit(&library->admissions_count, 1, memory_order_relaxed);
     }
-    for (i = 0;i < writers_count;i++) {
-        writers_queue[i] = timestamp;
+    if (ops_limit && atomic_fetch_add_explicit(&admissions_count, 1, memory_order_relaxed) + 1 == ops_limit) {
+        kill(getpid(), SIGTERM);
     }
 }
 
 /*!
- * @brief Function gets timestamp from system time.
+ * @brief Function gets timestamp (in nanoseconds) from monotonic clock. It is never 0, so 0 can be used to mark that
+ * thread is not in queue or library.
  *
- * @return Timestamp
+ * @return Timestamp in nanoseconds
  */
-time_t get_timestamp() {
-    return time(NULL);
+int64_t get_timestamp() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * NANOSECONDS_IN_SECOND + now.tv_nsec;
 }
 
 /*!
- * @brief Function gets random integer from min - max range (inclusive).
+ * @brief Function sleeps for given time or until signal_flag is reset - whichever comes first. It waits on
+ * shutdown_cond with monotonic clock deadline, so stopping threads does not have to wait for whole reading, writing or
+ * allow read time.
  *
- * @param min Minimum number that can be generated.
- * @param max Maximum number that can be generated.
- * @return Random integer
+ * @param nanoseconds Time to sleep in nanoseconds
+ */
+void sleep_interruptible(int64_t nanoseconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += nanoseconds / NANOSECONDS_IN_SECOND;
+    deadline.tv_nsec += nanoseconds % NANOSECONDS_IN_SECOND;
+    if (deadline.tv_nsec >= NANOSECONDS_IN_SECOND) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NANOSECONDS_IN_SECOND;
+    }
+    pthread_mutex_lock(&shutdown_mutex);
+    while (signal_flag) {
+        if (pthread_cond_timedwait(&shutdown_cond, &shutdown_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shutdown_mutex);
+}
+
+/*!
+ * @brief Blocks main thread until SIGINT or SIGTERM is received (signals have to be blocked before). Thread does not
+ * use any CPU time while waiting. In debug mode function wakes up every second to print library state, if
+ * stats_interval is set - it wakes up every stats_interval seconds to print latency percentiles. If bench_duration is
+ * set, function returns after bench_duration seconds even if no signal was received.
  */
-int get_random(int min, int max) {
-    int range = max - min + 1;
-    return (rand() % range) + min;
+void wait_for_signal() {
+    sigset_t signal_set;
+    sigemptyset(&signal_set);
+    sigaddset(&signal_set, SIGINT);
+    sigaddset(&signal_set, SIGTERM);
+    if (is_debug_run || stats_interval || bench_duration) {
+        struct timespec timeout = {1, 0};
+        int seconds = 0;
+        while (sigtimedwait(&signal_set, NULL, &timeout) < 0) {
+            if (errno != EAGAIN) {
+                continue;
+            }
+            seconds++;
+            if (bench_duration && seconds >= bench_duration) {
+                break;
+            }
+            if (is_debug_run) {
+                print_debug();
+            }
+            if (stats_interval && seconds % stats_interval == 0) {
+                print_latency();
+            }
+        }
+    } else {
+        int signal_number;
+        sigwait(&signal_set, &signal_number);
+    }
 }
 
 /*!
- * @brief Signal handler changes signal_flag to 0.
+ * @brief Resets signal_flag and wakes up all threads waiting on conditional variables, so every thread finishes its
+ * loop in bounded time and can be joined. Mutexes of all libraries are locked (in order of libraries, nobody else
+ * holds two of them), because every thread waits with mutex of library it is visiting. With other backends than
+ * RW_LOCK_NATIVE rw_lock of every library is shut down, so threads waiting for it give up (see rw_lock_shutdown).
  */
-void signal_handler() {
+void stop_threads() {
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        adaptive_mutex_lock(&libraries[i].mutex);
+    }
+    pthread_mutex_lock(&shutdown_mutex);
     signal_flag = 0;
+    pthread_cond_broadcast(&shutdown_cond);
+    pthread_mutex_unlock(&shutdown_mutex);
+    for (i = 0;i < libraries_count;i++) {
+        pthread_cond_broadcast(&libraries[i].readers_cond);
+        pthread_cond_broadcast(&libraries[i].library_drained_cond);
+    }
+    for (i = 0;i < readers_count;i++) {
+        pthread_cond_broadcast(&readers_state[i].cond);
+    }
+    for (i = 0;i < writers_count;i++) {
+        pthread_cond_broadcast(&writers_state[i].cond);
+    }
+    for (i = libraries_count - 1;i >= 0;i--) {
+        adaptive_mutex_unlock(&libraries[i].mutex);
+    }
+    for (i = 0;i < libraries_count && lock_backend != RW_LOCK_NATIVE;i++) {
+        rw_lock_shutdown(&libraries[i].rw_lock);
+    }
 }
 
 /*!
  * @brief Arguments interpreter. Checks program arguments and sets global variables or exits program if arguments are
  * incorrect.
  * 1. Reads two first arguments - writers and readers count and sets it to global variables.
- * 2. (optional) Checks next arguments and enters debug mode or sets up times.
+ * 2. (optional) Checks next arguments (in any order) and enters debug mode, sets up times (-t in seconds, -work in
+ * nanoseconds), latency statistics interval, benchmark duration and admissions limit, random numbers seed, distribution
+ * of times, lock backend, mutex mode, pin mode, big-reader lock mode, task mode, wake batch mode, cohort mode, trace
+ * file, adaptive read window mode, number of libraries, Zipf exponent of choosing libraries or deadline of visits (in
+ * milliseconds). Debug, big-reader lock, task, wake batch, trace, adaptive read window, seqlock and metrics modes work
+ * only with program's own scheme (RW_LOCK_NATIVE backend), deadline mode also with reader-writer library
+ * (RW_LOCK_FIFO and RW_LOCK_LIBRARIAN backends), big-reader lock, wake batch and trace modes and more than one library
+ * do not work in task mode, big-reader lock and wake batch modes do not work with each other nor with deadline mode,
+ * cohort mode works only in wake batch mode.
  *
  * @param argc Arguments count
  * @param argv Array of arguments
@@ -475,91 +2431,302 @@ void args_interpreter(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
+    seed = (uint64_t) time(NULL);
     writers_count = atoi(argv[1]);
-    writers_queue_count = writers_count;
     readers_count = atoi(argv[2]);
-    readers_queue_count = readers_count;
 
-    if (argc > 3 ) {
-        if (strcmp(argv[3], "-t") == 0) {
-            if (argc < 10) {
+    for (int i = 3;i < argc;i++) {
+        if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-work") == 0) {
+            if (argc < i + 7) {
                 printf(ERROR_ARGUMENTS_MESSAGE);
                 exit(EXIT_FAILURE);
             } else {
-                int temp;
-                min_reading_time = atoi(argv[4]);
-                max_reading_time = atoi(argv[5]);
-                if (min_reading_time > max_reading_time) {
-                    temp = min_reading_time;
-                    min_reading_time = max_reading_time;
-                    max_reading_time = temp;
-                }
-                min_writing_time = atoi(argv[6]);
-                max_writing_time = atoi(argv[7]);
-                if (min_writing_time > max_writing_time) {
-                    temp = min_writing_time;
-                    min_writing_time = max_writing_time;
-                    max_writing_time = temp;
-                }
-                min_allow_read_time = atoi(argv[8]);
-                max_allow_read_time = atoi(argv[9]);
-                if (min_allow_read_time > max_allow_read_time) {
-                    temp = min_allow_read_time;
-                    min_allow_read_time = max_allow_read_time;
-                    max_allow_read_time = temp;
-                }
+                int64_t unit = strcmp(argv[i], "-t") == 0 ? NANOSECONDS_IN_SECOND : 1;
+                read_time_range(&argv[i + 1], unit, &min_reading_time, &max_reading_time);
+                read_time_range(&argv[i + 3], unit, &min_writing_time, &max_writing_time);
+                read_time_range(&argv[i + 5], unit, &min_allow_read_time, &max_allow_read_time);
+                i += 6;
+            }
+        } else if (strcmp(argv[i], "-brlock") == 0) {
+            is_big_reader_lock = 1;
+        } else if (strcmp(argv[i], "-mutex") == 0) {
+            if (argc < i + 2 || adaptive_mutex_mode(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            mutex_mode = adaptive_mutex_mode(argv[++i]);
+        } else if (strcmp(argv[i], "-tasks") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            task_workers = atoi(argv[++i]);
+            if (!task_workers) {
+                task_workers = task_pool_default_workers();
+            }
+            is_task_run = 1;
+        } else if (strcmp(argv[i], "-wakebatch") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            wake_batch = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-pin") == 0) {
+            if (argc < i + 2 || topology_pin_mode(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            pin_mode = topology_pin_mode(argv[++i]);
+        } else if (strcmp(argv[i], "-cohort") == 0) {
+            is_cohort_run = 1;
+        } else if (strcmp(argv[i], "-adaptive") == 0) {
+            if (argc < i + 2 || atoll(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
             }
-        } else if (strcmp(argv[3], "-debug") == 0) {
+            target_writer_wait = atoll(argv[++i]) * NANOSECONDS_IN_MILLISECOND;
+            is_adaptive_run = 1;
+        } else if (strcmp(argv[i], "-libraries") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            libraries_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-zipf") == 0) {
+            if (argc < i + 2 || atof(argv[i + 1]) <= 0.0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            zipf_exponent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-trace") == 0) {
+            if (argc < i + 2) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            trace_path = argv[++i];
+            is_trace_run = 1;
+        } else if (strcmp(argv[i], "-debug") == 0) {
             is_debug_run = 1;
+        } else if (strcmp(argv[i], "-bench") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            bench_duration = atoi(argv[++i]);
+            is_bench_run = 1;
+        } else if (strcmp(argv[i], "-ops") == 0) {
+            if (argc < i + 2 || atoll(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            ops_limit = atoll(argv[++i]);
+            is_bench_run = 1;
+        } else if (strcmp(argv[i], "-seed") == 0) {
+            if (argc < i + 2) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-dist") == 0) {
+            if (argc < i + 2 || rng_distribution(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            time_distribution = rng_distribution(argv[++i]);
+        } else if (strcmp(argv[i], "-backend") == 0) {
+            if (argc < i + 2 || rw_lock_backend(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            lock_backend = rw_lock_backend(argv[++i]);
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-deadline") == 0) {
+            if (argc < i + 2 || atoll(argv[i + 1]) < 1) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            deadline_time = atoll(argv[++i]) * NANOSECONDS_IN_MILLISECOND;
+            is_deadline_run = 1;
+        } else if (strcmp(argv[i], "-seqlock") == 0) {
+            is_seqlock_run = 1;
+        } else if (strcmp(argv[i], "-metrics") == 0) {
+            if (argc < i + 2) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            metrics_target = argv[++i];
+            is_metrics_run = 1;
         } else {
             printf(ERROR_ARGUMENTS_MESSAGE);
             exit(EXIT_FAILURE);
         }
     }
-
-    if (argc == 11) {
-        if (strcmp(argv[10], "-debug") == 0) {
-            is_debug_run = 1;
-        } else {
-            printf(ERROR_ARGUMENTS_MESSAGE);
+    if (((is_debug_run || is_big_reader_lock || is_task_run || wake_batch || is_trace_run || is_adaptive_run ||
+          is_seqlock_run || is_metrics_run) && lock_backend != RW_LOCK_NATIVE) ||
+        (is_deadline_run && lock_backend != RW_LOCK_NATIVE && lock_backend != RW_LOCK_FIFO &&
+         lock_backend != RW_LOCK_LIBRARIAN) ||
+        ((is_big_reader_lock || wake_batch || is_trace_run || is_deadline_run || is_seqlock_run ||
+          libraries_count > 1) && is_task_run) ||
+        (is_big_reader_lock && wake_batch) ||
+        ((is_big_reader_lock || wake_batch) && (is_deadline_run || is_seqlock_run)) ||
+        (is_cohort_run && !wake_batch)) {
+        printf(ERROR_ARGUMENTS_MESSAGE);
+        exit(EXIT_FAILURE);
+    }
+    is_status_logged = !is_debug_run && !is_bench_run && lock_backend == RW_LOCK_NATIVE && libraries_count == 1;
+    is_queued_on_arrival = is_trace_run || is_deadline_run || libraries_count > 1;
+    if (is_trace_run) {
+        int error_line = trace_load(&trace, trace_path, readers_count, writers_count);
+        if (error_line) {
+            printf(error_line < 0 ? "Can not read trace file %s\n" : "Wrong record in trace file %s at line %i\n",
+                   trace_path, error_line);
             exit(EXIT_FAILURE);
         }
     }
+}
 
-    if (argc > 11) {
-        printf(ERROR_ARGUMENTS_MESSAGE);
-        exit(EXIT_FAILURE);
+/*!
+ * @brief Function reads range of times from two following arguments. If minimum is greater than maximum, they are
+ * swapped.
+ *
+ * @param arguments Two arguments - minimum and maximum time
+ * @param unit Number of nanoseconds in time unit used in arguments
+ * @param min Minimum time (in nanoseconds) to set
+ * @param max Maximum time (in nanoseconds) to set
+ */
+void read_time_range(char **arguments, int64_t unit, int64_t *min, int64_t *max) {
+    *min = atoll(arguments[0]) * unit;
+    *max = atoll(arguments[1]) * unit;
+    if (*min > *max) {
+        int64_t temp = *min;
+        *min = *max;
+        *max = temp;
     }
 }
 
 /*!
- * @brief Allocates memory for global variables.
+ * @brief Allocates memory for global variables. Arrays of per-thread states, slots and histograms are allocated with
+ * topology_alloc, so on machine with more than one NUMA node every thread's state is in memory of its node.
  */
 void variables_initializer() {
-    srand(time(NULL));
-    writers_in_library = malloc(writers_count * sizeof(time_t));
-    writers_queue = malloc(writers_count * sizeof(time_t));
-    readers_in_library = malloc(readers_count * sizeof(time_t));
-    readers_queue = malloc(readers_count * sizeof(time_t));
-    writers_conds = malloc(writers_count * sizeof(pthread_cond_t));
-    pthread_mutex_init(&mutex, NULL);
-    pthread_cond_init(&readers_cond, NULL);
+    topology_init();
+    cohorts_count = is_cohort_run ? topology_nodes_count() : 1;
+    writers_state = topology_alloc(writers_count, sizeof(struct writer_state));
+    readers_state = topology_alloc(readers_count, sizeof(struct reader_state));
+    if (is_big_reader_lock) {
+        readers_slots = topology_alloc(readers_count, sizeof(struct reader_slot));
+    }
+    readers_latency = topology_alloc(readers_count, sizeof(struct latency_histograms));
+    writers_latency = topology_alloc(writers_count, sizeof(struct latency_histograms));
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    int i;
+    for (i = 0;i < readers_count;i++) {
+        pthread_cond_init(&readers_state[i].cond, NULL);
+        readers_state[i].woken = 0;
+        readers_state[i].in_library = 0;
+        histogram_init(&readers_latency[i].queue_wait);
+        histogram_init(&readers_latency[i].in_library);
+    }
+    for (i = 0;i < writers_count;i++) {
+        pthread_cond_init(&writers_state[i].cond, &cond_attr);
+        writers_state[i].granted = 0;
+        writers_state[i].in_library = 0;
+        histogram_init(&writers_latency[i].queue_wait);
+        histogram_init(&writers_latency[i].in_library);
+    }
+    libraries = aligned_alloc(CACHE_LINE_SIZE, libraries_count * sizeof(struct library));
+    for (i = 0;i < libraries_count;i++) {
+        struct library *library = &libraries[i];
+        adaptive_mutex_init(&library->mutex, mutex_mode);
+        pthread_cond_init(&library->readers_cond, &cond_attr);
+        pthread_cond_init(&library->library_drained_cond, NULL);
+        atomic_init(&library->writer_notification, 0);
+        library->writers_in_library_count = 0;
+        library->readers_in_library_count = 0;
+        library->writers_queue_count = 0;
+        library->readers_queue_count = 0;
+        library->writers_heap = malloc(writers_count * sizeof(int));
+        library->writers_heap_size = 0;
+        library->next_writer_ticket = 0;
+        library->waiting_readers = malloc(readers_count * sizeof(int));
+        library->waiting_readers_head = calloc(cohorts_count, sizeof(int));
+        library->waiting_readers_count = calloc(cohorts_count, sizeof(int));
+        library->parked_readers = malloc(readers_count * sizeof(int));
+        library->parked_readers_count = 0;
+        library->draining_writer = NULL;
+        library->read_window = min_allow_read_time;
+        library->writer_waits_count = 0;
+        library->read_windows_count = 0;
+        library->read_windows_time = 0;
+        atomic_init(&library->readers_arrivals_count, 0);
+        atomic_init(&library->admissions_count, 0);
+        seqlock_init(&library->seqlock);
+    }
+    pthread_condattr_destroy(&cond_attr);
+    if (zipf_exponent > 0.0 && libraries_count > 1) {
+        libraries_weights = malloc(libraries_count * sizeof(double));
+        rng_zipf_weights(libraries_weights, libraries_count, zipf_exponent);
+    }
+    pthread_mutex_init(&shutdown_mutex, NULL);
+    pthread_condattr_t shutdown_cond_attr;
+    pthread_condattr_init(&shutdown_cond_attr);
+    pthread_condattr_setclock(&shutdown_cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&shutdown_cond, &shutdown_cond_attr);
+    pthread_condattr_destroy(&shutdown_cond_attr);
 }
 
 /*!
  * @brief Frees memory allocated for global variables.
  */
 void cleaner() {
-    pthread_mutex_destroy(&mutex);
-    pthread_cond_destroy(&readers_cond);
-    for (int i = 0;i < writers_count;i++) {
-        pthread_cond_destroy(&writers_conds[i]);
-    }
-    free(writers_in_library);
-    free(writers_queue);
-    free(readers_in_library);
-    free(readers_queue);
-    free(writers_conds);
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        struct library *library = &libraries[i];
+        if (lock_backend != RW_LOCK_NATIVE) {
+            rw_lock_destroy(&library->rw_lock);
+        }
+        adaptive_mutex_destroy(&library->mutex);
+        pthread_cond_destroy(&library->readers_cond);
+        pthread_cond_destroy(&library->library_drained_cond);
+        free(library->writers_heap);
+        free(library->waiting_readers);
+        free(library->waiting_readers_head);
+        free(library->waiting_readers_count);
+        free(library->parked_readers);
+    }
+    free(libraries);
+    free(libraries_weights);
+    pthread_mutex_destroy(&shutdown_mutex);
+    pthread_cond_destroy(&shutdown_cond);
+    for (i = 0;i < writers_count;i++) {
+        pthread_cond_destroy(&writers_state[i].cond);
+    }
+    for (i = 0;i < readers_count;i++) {
+        pthread_cond_destroy(&readers_state[i].cond);
+    }
+    free(writers_state);
+    free(readers_state);
+    if (is_big_reader_lock) {
+        free(readers_slots);
+    }
+    free(readers_latency);
+    free(writers_latency);
+    if (is_task_run) {
+        task_pool_destroy();
+        free(readers_tasks);
+        free(writers_tasks);
+    }
+    if (is_trace_run) {
+        trace_destroy(&trace);
+    }
+    topology_destroy();
 }
 
 #pragma clang diagnostic pop
@@ -3,10 +3,11 @@
  * Readers and Writers - implementation 2
  *
  * Implementation with no starvation of writers or readers. It uses conditional variables - one for each reader and
- * one for each writer. In this implementation there is an additional thread - librarian. All readers and writers wait
- * in FIFO queue. Librarian checks every second who is at first position at queue - if it's reader librarian waits till
- * no writer is in library (if there was any). Then it sends signal to reader that he can come in. If there is a writer
- * at first position in queue - librarian waits till everyone leave library and then sends signal to the writer.
+ * one for each writer. All readers and writers wait in FIFO queue. There is no dedicated librarian thread - librarian's
+ * decision is made inline (under mutex) every time state of queue or library changes: if there is a reader at first
+ * position in queue and no writer is in library, reader is let in. If there is a writer at first position in queue and
+ * library is empty, writer is let in. Thread that is let in is moved from queue to library by the librarian and gets
+ * its granted flag set before it is signalled, so no signal can be lost.
  *
  * @author Mateusz Wawreszuk
  */
@@ -29,11 +30,69 @@
 #include <string.h>
 #include <time.h>
 #include <signal.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sched.h>
+
+#include "status_log.h"
+#include "histogram.h"
+#include "rng.h"
+#include "rw_lock.h"
+#include "task_pool.h"
+#include "adaptive_mutex.h"
+#include "topology.h"
+#include "trace.h"
+#include "seqlock.h"
+#include "metrics.h"
+
+/*!
+ * @brief Number of nanoseconds in one second.
+ */
+#define NANOSECONDS_IN_SECOND 1000000000LL
+/*!
+ * @brief Number of nanoseconds in one millisecond.
+ */
+#define NANOSECONDS_IN_MILLISECOND 1000000LL
+
+/*!
+ * @brief Time (in nanoseconds) that optimistic reader sleeps (in standard mode) before it checks again if writer has
+ * finished writing (seqlock mode).
+ */
+#define SEQLOCK_BACKOFF_TIME NANOSECONDS_IN_MILLISECOND
+
+/*!
+ * @brief Time (in nanoseconds) that thread which gave up its visit at deadline waits before it arrives again (deadline
+ * mode). It doubles with every next visit given up in a row, up to DEADLINE_MAX_BACKOFF_TIME (see back_off).
+ */
+#define DEADLINE_BACKOFF_TIME (NANOSECONDS_IN_MILLISECOND / 10)
+/*!
+ * @brief Maximal time (in nanoseconds) that thread which gave up its visit at deadline waits before it arrives again.
+ */
+#define DEADLINE_MAX_BACKOFF_TIME (100 * NANOSECONDS_IN_MILLISECOND)
+
+/*!
+ * @brief Number of library state changes that can wait in status log for printing.
+ */
+#define STATUS_LOG_CAPACITY 65536
+
+/*!
+ * @brief Cache line size - threads states (see struct thread_state) are aligned to it.
+ */
+#define CACHE_LINE_SIZE 64
+
+/*!
+ * @brief Alignment of readers and writers states (see struct thread_state) - one cache line, so states of neighbouring
+ * threads never share a line. Building with -DTHREAD_STATE_ALIGNMENT=8 packs states (no padding), so benchmark can
+ * compare both layouts (see bench target in Makefile).
+ */
+#ifndef THREAD_STATE_ALIGNMENT
+#define THREAD_STATE_ALIGNMENT CACHE_LINE_SIZE
+#endif
 
 /*!
  * @brief Wrong arguments error message.
  */
-#define ERROR_ARGUMENTS_MESSAGE "Usage: ReaderAndWriters2 number_of_writers number_of_readers [-t min_reading_time max_reading_time min_writing_time max_writing_time] [-debug]\n"
+#define ERROR_ARGUMENTS_MESSAGE "Usage: ReaderAndWriters2 number_of_writers number_of_readers [-t min_reading_time max_reading_time min_writing_time max_writing_time] [-work min_reading_ns max_reading_ns min_writing_ns max_writing_ns] [-debug] [-batch] [-stats interval] [-bench seconds] [-ops count] [-seed number] [-dist uniform|exp|pareto] [-backend native|pthread|phasefair|fifo|librarian] [-tasks workers] [-mutex pthread|adaptive|mcs] [-pin none|cpu|node] [-trace file] [-libraries count] [-zipf exponent] [-deadline ms] [-seqlock] [-metrics file|unix:socket]\n"
 
 /*!
  * @brief Thread kind to mark there is no one at this position in queue or library.
@@ -48,6 +107,15 @@
  */
 #define WRITER_KIND 2
 
+/*!
+ * @brief Task step: reader or writer waits in queue.
+ */
+#define CLIENT_WAITING 0
+/*!
+ * @brief Task step: reader or writer is in library.
+ */
+#define CLIENT_IN_LIBRARY 1
+
 /*!
  * @brief Thread presence in queue or in library.
  */
@@ -63,54 +131,365 @@ struct presence {
 /*!
  * @brief when thread get to this position in queue or to library
  */
-    time_t timestamp;
+    int64_t timestamp;
+};
+
+/*!
+ * @brief Reader's or writer's state used to let it in to library. It fills exactly one cache line and state of every
+ * thread is in its own line, so signalling one thread does not invalidate state of its neighbours.
+ */
+struct thread_state {
+/*!
+ * @brief conditional variable that thread waits on till it is let in to library
+ */
+    _Alignas(THREAD_STATE_ALIGNMENT) pthread_cond_t cond;
+/*!
+ * @brief flag set by librarian when thread is let in to library
+ */
+    int granted;
+/*!
+ * @brief position of thread in queue ring buffer (set by get_to_queue), so thread whose deadline passed takes itself
+ * off from queue without searching it (see give_up)
+ */
+    int queue_position;
+/*!
+ * @brief timestamp set (by get_to_queue) when thread gets to queue
+ */
+    int64_t enqueued_at;
+};
+
+/*!
+ * @brief Library - queue, presence in library and mutex guarding them. There is one library by default, with
+ * -libraries there are libraries_count independent libraries (resource shards) and every library has its own admission
+ * state and its own librarian (librarian is called with mutex of its library locked). Every library starts at its own
+ * cache line, so locking one library does not invalidate its neighbours.
+ */
+struct library {
+/*!
+ * @brief just a mutex (see adaptive_mutex.h - by default plain pthread_mutex_t)
+ */
+    _Alignas(CACHE_LINE_SIZE) struct adaptive_mutex mutex;
+/*!
+ * @brief common writers and readers queue - ring buffer, first thread in queue is at queue_head position and
+ * queue_size threads are stored at following positions (modulo queue_capacity). In deadline mode positions of threads
+ * that gave up are left with NO_KIND presence between them (see give_up and compact_queue)
+ */
+    struct presence *queue;
+/*!
+ * @brief position of first thread in queue
+ */
+    int queue_head;
+/*!
+ * @brief number of positions in queue (from first to last thread in queue)
+ */
+    int queue_size;
+/*!
+ * @brief presence in library - common for writers and readers, every thread has its own fixed position (see
+ * get_library_slot), so it does not have to be searched for
+ */
+    struct presence *in_library;
+/*!
+ * @brief number of readers in queue (updated by get_to_queue and leave_queue)
+ */
+    int readers_queue_count;
+/*!
+ * @brief number of writers in queue (updated by get_to_queue and leave_queue)
+ */
+    int writers_queue_count;
+/*!
+ * @brief number of readers in library (updated by get_to_library and leave_library)
+ */
+    int readers_in_library_count;
+/*!
+ * @brief number of writers in library (updated by get_to_library and leave_library)
+ */
+    int writers_in_library_count;
+/*!
+ * @brief lock used instead of program's own scheme if lock_backend is not RW_LOCK_NATIVE
+ */
+    struct rw_lock rw_lock;
+/*!
+ * @brief number of admissions to library (counted only if there is more than one library)
+ */
+    atomic_llong admissions_count;
+/*!
+ * @brief kind of thread let in to library last time (NO_KIND at the beginning) - when librarian lets in thread of the
+ * other kind, phase of its kind starts (see metrics_count_phase_switch)
+ */
+    int phase_kind;
+/*!
+ * @brief sequence lock of library's book - written by writers let in by librarian, read optimistically by readers
+ * (seqlock mode)
+ */
+    struct seqlock seqlock;
+};
+
+/*!
+ * @brief Reader or writer run as task on task pool (task mode). Task waiting in queue is parked - it is neither in run
+ * queue nor in timers heap, and librarian submits it again when it lets it in.
+ */
+struct client_task {
+/*!
+ * @brief task run by task pool (first member, so pointer to task is pointer to client_task too)
+ */
+    struct task task;
+/*!
+ * @brief thread kind (READER_KIND / WRITER_KIND)
+ */
+    int kind;
+/*!
+ * @brief reader or writer id
+ */
+    int id;
+/*!
+ * @brief step of reader or writer (CLIENT_WAITING / CLIENT_IN_LIBRARY)
+ */
+    int step;
+/*!
+ * @brief flag set when task is parked
+ */
+    int parked;
+/*!
+ * @brief random number generator of reader or writer
+ */
+    struct rng rng;
 };
 
-void print();
+void print(struct library *library);
+void print_debug();
+void print_debug_library(struct presence *queue_copy, int queue_copy_size, struct presence *in_library_copy,
+                         int64_t timestamp);
+void print_latency();
+void print_throughput(int64_t elapsed);
+void print_libraries();
 void* reader(void* arg);
 void* writer(void* arg);
-void* librarian();
-void write_book(int writer_id);
-void read_books(int reader_id);
-int get_random(int min, int max);
-time_t get_timestamp();
+void librarian(struct library *library);
+void write_book(struct library *library, int writer_id, int64_t writing_time);
+void read_books(struct library *library, int reader_id, int64_t reading_time);
+void write_with_lock(struct library *library, int writer_id, struct rng *rng, int64_t *backoff);
+void read_with_lock(struct library *library, int reader_id, struct rng *rng, int64_t *backoff);
+int64_t get_timestamp();
 void init_queue();
-void signal_handler();
+void sleep_interruptible(int64_t nanoseconds);
+void spend_time(int64_t duration);
+void count_admission(struct library *library);
+void wait_for_signal();
+void stop_threads();
 void args_interpreter(int argc, char **argv);
+void read_time_range(char **arguments, int64_t unit, int64_t *min, int64_t *max);
 void variables_initializer();
 void cleaner();
-int get_readers_queue_count();
-int get_writers_queue_count();
-int get_writers_in_library_count();
-int get_readers_in_library_count();
-void get_to_queue(int kind, int id);
-void leave_queue();
-void get_to_library(int kind, int id);
-void leave_library(int kind, int id);
+int get_readers_queue_count(struct library *library);
+int get_writers_queue_count(struct library *library);
+int get_writers_in_library_count(struct library *library);
+int get_readers_in_library_count(struct library *library);
+void update_count(int kind, int *readers_counter, int *writers_counter, int delta);
+int64_t get_to_queue(struct library *library, int kind, int id);
+void leave_queue(struct library *library);
+void drop_given_up(struct library *library);
+void compact_queue(struct library *library);
+void back_off(int64_t *backoff);
+void give_up(struct library *library, int kind, int id);
+int wait_for_admission(struct library *library, int kind, int id);
+void print_deadlines();
+void read_optimistically(struct library *library, int reader_id, int64_t reading_time, int64_t arrived_at);
+void wait_for_writing(struct library *library);
+void print_seqlock();
+void get_to_library(struct library *library, int kind, int id);
+void leave_library(struct library *library, int kind, int id);
+int get_library_slot(int kind, int id);
+struct thread_state* get_thread_state(int kind, int id);
+int get_metrics_role(int kind);
+int64_t take_admission(struct library *library, int kind, int id);
+int64_t return_to_queue(struct library *library, int kind, int id);
+void arrive_at_library(struct library *library, int kind, int id, int64_t arrived_at);
+struct library* choose_library(struct rng *rng);
+void wake_up(int kind, int id);
+int64_t wait_for_arrival(int *record, int64_t *arrived_at);
+void start_tasks();
+void run_client_task(struct task *task);
 
 /*!
- * @brief Loop in main function works until signal_flag is set. When SIGINT signal is received, flag is changed to 0 and
- * loop stops.
+ * @brief All threads work until signal_flag is set. When SIGINT or SIGTERM signal is received, main function changes
+ * flag to 0 (holding mutexes of all libraries and shutdown_mutex) and wakes up all waiting threads, so they can finish
+ * their loops.
  */
 volatile int signal_flag = 1;
 
 /*!
- * @brief Just a mutex.
+ * @brief Mutex guarding shutdown_cond.
+ */
+pthread_mutex_t shutdown_mutex;
+/*!
+ * @brief Conditional variable that threads wait on instead of sleep(), so they are woken up at shutdown.
+ */
+pthread_cond_t shutdown_cond;
+
+/*!
+ * @brief Array of libraries (see struct library).
+ */
+struct library *libraries;
+/*!
+ * @brief Number of libraries (set by -libraries, 1 by default).
+ */
+int libraries_count = 1;
+/*!
+ * @brief Cumulative weights of libraries (see rng_zipf_weights) used to choose library when -zipf is set, NULL if
+ * every library is chosen with the same probability.
+ */
+double *libraries_weights = NULL;
+/*!
+ * @brief Exponent of Zipf distribution that libraries are chosen from (set by -zipf, 0 means uniform distribution).
+ */
+double zipf_exponent = 0.0;
+/*!
+ * @brief Flag set when threads get to queue at theirs arrivals, not when they leave library - in trace mode (thread is
+ * not waiting till its next arrival), in deadline mode (every visit has its own deadline) and when there is more than
+ * one library (thread gets to queue of library it chooses for its next visit, see arrive_at_library).
  */
-pthread_mutex_t mutex;
+int is_queued_on_arrival = 0;
 /*!
- * @brief Array of conditional variables to handle readers.
+ * @brief Array of readers states (see struct thread_state). Position in array is an identifier of reader.
  */
-pthread_cond_t *readers_conds;
+struct thread_state *readers_state;
 /*!
- * @brief Array of conditional variables to handle writers.
+ * @brief Array of writers states (see struct thread_state). Position in array is an identifier of writer.
  */
-pthread_cond_t *writers_conds;
+struct thread_state *writers_state;
 
 /*!
  * @brief Flag marking debug mode.
  */
 int is_debug_run = 0;
+/*!
+ * @brief Flag marking batch admission mode - librarian lets in all readers from the beginning of queue (up to first
+ * writer) at once, instead of one reader per call.
+ */
+int is_batch_admission = 0;
+/*!
+ * @brief Interval (in seconds) of printing latency percentiles while program works. If it's 0, percentiles are printed
+ * only at the end.
+ */
+int stats_interval = 0;
+/*!
+ * @brief Flag marking benchmark mode (set by -bench or -ops). In benchmark mode time in library is spent on busy work
+ * instead of sleeping, library state is not printed and admissions per second are printed at the end.
+ */
+int is_bench_run = 0;
+/*!
+ * @brief Benchmark duration in seconds. If it's 0, program works until signal is received (or ops_limit is reached).
+ */
+int bench_duration = 0;
+/*!
+ * @brief Number of admissions to library (readers and writers together) after which program stops. If it's 0, there is
+ * no limit.
+ */
+long long ops_limit = 0;
+/*!
+ * @brief Number of admissions to library (readers and writers together). It is counted only if ops_limit is set.
+ */
+atomic_llong admissions_count = 0;
+/*!
+ * @brief Seed of random number generators (from -seed argument or from clock). Every thread seeds its own generator
+ * with it and its own stream number, so runs with the same seed draw the same times.
+ */
+uint64_t seed;
+/*!
+ * @brief Distribution of reading and writing times (RNG_UNIFORM / RNG_EXPONENTIAL / RNG_PARETO).
+ */
+int time_distribution = RNG_UNIFORM;
+/*!
+ * @brief Reader-writer lock backend (RW_LOCK_NATIVE - program's own scheme, RW_LOCK_PTHREAD, RW_LOCK_PHASE_FAIR,
+ * RW_LOCK_FIFO or RW_LOCK_LIBRARIAN).
+ */
+int lock_backend = RW_LOCK_NATIVE;
+/*!
+ * @brief Flag set when library state is printed by status log - in standard mode (not debug or benchmark) with
+ * program's own scheme (other backends do not keep library state).
+ */
+int is_status_logged = 0;
+/*!
+ * @brief Flag marking task mode (set by -tasks). Readers and writers are tasks run by task_workers worker threads
+ * instead of having theirs own threads.
+ */
+int is_task_run = 0;
+/*!
+ * @brief Number of worker threads in task mode.
+ */
+int task_workers = 0;
+/*!
+ * @brief Mode of mutex (ADAPTIVE_MUTEX_PTHREAD / ADAPTIVE_MUTEX_SPIN / ADAPTIVE_MUTEX_MCS, set by -mutex).
+ */
+int mutex_mode = ADAPTIVE_MUTEX_PTHREAD;
+/*!
+ * @brief Pin mode of readers, writers and task pool workers (TOPOLOGY_PIN_NONE / TOPOLOGY_PIN_CPU / TOPOLOGY_PIN_NODE,
+ * set by -pin).
+ */
+int pin_mode = TOPOLOGY_PIN_NONE;
+/*!
+ * @brief Flag marking trace mode (set by -trace). Readers and writers replay records of trace (see trace.h) - they get
+ * to queue at arrival times of theirs records and spend hold times of records in library, so arrivals are open-loop.
+ * Thread leaving library does not get back to queue till its next arrival.
+ */
+int is_trace_run = 0;
+/*!
+ * @brief Path of trace file (trace mode).
+ */
+char *trace_path;
+/*!
+ * @brief Trace replayed in trace mode.
+ */
+struct trace trace;
+/*!
+ * @brief Timestamp of start of trace replay - arrival time of record is trace_started_at + record's timestamp.
+ */
+int64_t trace_started_at;
+/*!
+ * @brief Flag marking deadline mode (set by -deadline). Reader or writer that is not let in to library before its
+ * deadline gives up its visit (it is taken off from queue) and arrives again with next visit.
+ */
+int is_deadline_run = 0;
+/*!
+ * @brief Time (in nanoseconds) from getting to queue to deadline of visit in deadline mode. If it's 0, thread gives up
+ * when it is not let in at once (by librarian called at its arrival) - then writer is let in only if it arrives when
+ * library is empty and nobody waits, so with readers always in library writers never get in.
+ */
+int64_t deadline_time = 0;
+/*!
+ * @brief Number of readers visits that gave up at deadline (deadline mode).
+ */
+atomic_llong readers_timeouts_count = 0;
+/*!
+ * @brief Number of writers visits that gave up at deadline (deadline mode).
+ */
+atomic_llong writers_timeouts_count = 0;
+/*!
+ * @brief Flag marking seqlock mode (set by -seqlock). Readers do not get to queue and do not lock mutex - they read
+ * optimistically (see read_optimistically) and retry if writer was writing in the meantime. Writers are let in by
+ * librarian as before.
+ */
+int is_seqlock_run = 0;
+/*!
+ * @brief Number of optimistic reads that had to be retried (seqlock mode).
+ */
+atomic_llong seqlock_retries_count = 0;
+/*!
+ * @brief Flag marking metrics export (set by -metrics, see metrics.h).
+ */
+int is_metrics_run = 0;
+/*!
+ * @brief Metrics file path or "unix:" followed by Unix socket path (metrics export).
+ */
+char *metrics_target;
+/*!
+ * @brief Array of readers tasks (task mode). Position in array is an identifier of reader.
+ */
+struct client_task *readers_tasks;
+/*!
+ * @brief Array of writers tasks (task mode). Position in array is an identifier of writer.
+ */
+struct client_task *writers_tasks;
 
 /*!
  * @brief Number of readers.
@@ -122,43 +501,55 @@ int readers_count;
 int writers_count;
 
 /*!
- * @brief Common writers and readers queue.
+ * @brief Number of positions in queue of every library (number of readers and writers - every thread can be in queue
+ * at most once). In deadline mode it is doubled, so positions left by threads that gave up fill queue at most once
+ * per queue_capacity / 2 visits (see compact_queue).
+ */
+int queue_capacity;
+
+/*!
+ * @brief Array of latency histograms of readers - recorded only by reader thread itself.
+ *
+ * Position in array is an identifier of reader.
  */
-struct presence *queue;
+struct latency_histograms *readers_latency;
 /*!
- * @brief Presence in library - common for writers and readers.
+ * @brief Array of latency histograms of writers - recorded only by writer thread itself.
+ *
+ * Position in array is an identifier of writer.
  */
-struct presence *in_library;
+struct latency_histograms *writers_latency;
 
 /*!
- * @brief Minimum time that reader spends in library.
+ * @brief Minimum time (in nanoseconds) that reader spends in library.
  */
-int min_reading_time = 0;
+int64_t min_reading_time = 0;
 /*!
- * @brief Maximum time that reader spends in library.
+ * @brief Maximum time (in nanoseconds) that reader spends in library.
  */
-int max_reading_time = 5;
+int64_t max_reading_time = 5 * NANOSECONDS_IN_SECOND;
 /*!
- * @brief Minimum time that writer spends in library.
+ * @brief Minimum time (in nanoseconds) that writer spends in library.
  */
-int min_writing_time = 5;
+int64_t min_writing_time = 5 * NANOSECONDS_IN_SECOND;
 /*!
- * @brief Maximum time that writer spends in library.
+ * @brief Maximum time (in nanoseconds) that writer spends in library.
  */
-int max_writing_time = 15;
+int64_t max_writing_time = 15 * NANOSECONDS_IN_SECOND;
 
 /*!
- * @brief Creates readers, writers and librarian threads. After that function works in endless loop and (in debug mode)
- * prints library state every second. Loop can be stopped with SIGINT signal (ctrl+c). In that case function cancels all
- * threads and frees memory allocated for variables.
+ * @brief Creates readers and writers threads (in task mode - task pool running readers and writers tasks). SIGINT and
+ * SIGTERM are blocked before any thread is created, so only main thread receives them. After that function blocks until
+ * signal is received (in debug mode it wakes up every second to print library state and every stats_interval seconds to
+ * print latency percentiles). Then function stops all threads, joins them, prints latency percentiles (and admissions
+ * per second in benchmark mode) and frees memory allocated for variables. In benchmark mode signal is not needed -
+ * program stops after bench_duration seconds or after ops_limit admissions.
  *
  * @param argc arguments count
  * @param argv arguments array
  * @return 0 (no error code)
  */
 int main(int argc, char* argv[]) {
-    signal(SIGINT, signal_handler);
-
     args_interpreter(argc, argv);
     variables_initializer();
 
@@ -166,45 +557,104 @@ int main(int argc, char* argv[]) {
     int *writer_ids = malloc(writers_count * sizeof(int));
     pthread_t *readers = malloc(readers_count * sizeof(pthread_t));
     pthread_t *writers = malloc(writers_count * sizeof(pthread_t));
-    pthread_t librarian_t;
 
+    if (is_metrics_run && metrics_start(metrics_target, libraries_count, readers_count, writers_count,
+                                        readers_latency, writers_latency)) {
+        printf("Can not export metrics to %s\n", metrics_target);
+        exit(EXIT_FAILURE);
+    }
     init_queue();
-
-    print();
-
     int i;
+    if (lock_backend != RW_LOCK_NATIVE) {
+        for (i = 0;i < libraries_count;i++) {
+            rw_lock_init(&libraries[i].rw_lock, lock_backend, RW_LOCK_READ_WINDOW);
+        }
+    }
 
-    for (i = 0;i < readers_count;i++) {
-        pthread_cond_init(&readers_conds[i], NULL);
-        reader_ids[i] = i;
-        pthread_create(&readers[i], NULL, reader, (void *) &reader_ids[i]);
+    if (is_status_logged) {
+        status_log_start(STATUS_LOG_CAPACITY);
     }
-    for (i = 0;i < writers_count;i++) {
-        pthread_cond_init(&writers_conds[i], NULL);
-        writer_ids[i] = i;
-        pthread_create(&writers[i], NULL, writer, (void *) &writer_ids[i]);
+    print(&libraries[0]);
+
+    sigset_t signal_set;
+    sigemptyset(&signal_set);
+    sigaddset(&signal_set, SIGINT);
+    sigaddset(&signal_set, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signal_set, NULL);
+
+    int64_t started_at = get_timestamp();
+    trace_started_at = started_at;
+    if (is_task_run) {
+        start_tasks();
+    }
+    if (lock_backend == RW_LOCK_NATIVE) {
+        adaptive_mutex_lock(&libraries[0].mutex);
+        librarian(&libraries[0]);
+        adaptive_mutex_unlock(&libraries[0].mutex);
     }
-    pthread_create(&librarian_t, NULL, librarian, NULL);
 
-    if (is_debug_run) {
-        while (signal_flag) {
-            sleep(1);
-            pthread_mutex_lock(&mutex);
-            print();
-            pthread_mutex_unlock(&mutex);
+    if (!is_task_run) {
+        for (i = 0;i < readers_count;i++) {
+            reader_ids[i] = i;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            topology_pin(&attr, pin_mode, i, readers_count);
+            pthread_create(&readers[i], &attr, reader, (void *) &reader_ids[i]);
+            pthread_attr_destroy(&attr);
+        }
+        for (i = 0;i < writers_count;i++) {
+            writer_ids[i] = i;
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            topology_pin(&attr, pin_mode, i, writers_count);
+            pthread_create(&writers[i], &attr, writer, (void *) &writer_ids[i]);
+            pthread_attr_destroy(&attr);
         }
-    } else {
-        while (signal_flag);
     }
+
+    wait_for_signal();
+    int64_t elapsed = get_timestamp() - started_at;
     printf("\nCleaning up...\n\n");
 
-    for (i = 0;i < readers_count;i++) {
-        pthread_cancel(readers[i]);
+    stop_threads();
+    if (is_task_run) {
+        task_pool_stop();
+    } else {
+        for (i = 0;i < readers_count;i++) {
+            pthread_join(readers[i], NULL);
+        }
+        for (i = 0;i < writers_count;i++) {
+            pthread_join(writers[i], NULL);
+        }
     }
-    for (i = 0;i < writers_count;i++) {
-        pthread_cancel(writers[i]);
+    if (is_status_logged) {
+        status_log_stop();
+    }
+    if (is_metrics_run) {
+        metrics_stop();
+    }
+    print_latency();
+    if (is_bench_run) {
+        print_throughput(elapsed);
+    }
+    if (is_task_run) {
+        task_pool_print_stats();
+    }
+    if (is_trace_run) {
+        trace_print_stats(&trace);
+    }
+    if (libraries_count > 1) {
+        print_libraries();
+    }
+    if (is_deadline_run) {
+        print_deadlines();
+    }
+    if (is_seqlock_run) {
+        print_seqlock();
+    }
+    for (i = 0;i < libraries_count;i++) {
+        adaptive_mutex_print_stats(&libraries[i].mutex);
     }
-    pthread_cancel(librarian_t);
 
     cleaner();
     free(readers);
@@ -216,372 +666,1207 @@ int main(int argc, char* argv[]) {
 }
 
 /*!
- * @brief Function counts writers in queue.
+ * @brief Function returns number of writers in queue. Counter is kept up to date
+ * incrementally, so it takes constant time.
  *
+ * @param library Library
  * @return Number of writers in queue
  */
-int get_writers_queue_count() {
-    int count = 0;
-    for (int i = 0;i < writers_count + readers_count;i++) {
-        if (queue[i].kind == WRITER_KIND) {
-            count++;
-        }
-    }
-    return count;
+int get_writers_queue_count(struct library *library) {
+    return library->writers_queue_count;
 }
 
 /*!
- * @brief Function counts readers in queue.
+ * @brief Function returns number of readers in queue. Counter is kept up to date
+ * incrementally, so it takes constant time.
  *
+ * @param library Library
  * @return Number of readers in queue
  */
-int get_readers_queue_count() {
-    int count = 0;
-    for (int i = 0;i < writers_count + readers_count;i++) {
-        if (queue[i].kind == READER_KIND) {
-            count++;
-        }
-    }
-    return count;
+int get_readers_queue_count(struct library *library) {
+    return library->readers_queue_count;
 }
 
 /*!
- * @brief Function counts writers in library.
+ * @brief Function returns number of writers in library. Counter is kept up to date
+ * incrementally, so it takes constant time.
  *
+ * @param library Library
  * @return Number of writers in library
  */
-int get_writers_in_library_count() {
-    int count = 0;
-    for (int i = 0;i < writers_count + readers_count;i++) {
-        if (in_library[i].kind == WRITER_KIND) {
-            count++;
-        }
-    }
-    return count;
+int get_writers_in_library_count(struct library *library) {
+    return library->writers_in_library_count;
 }
 
 /*!
- * @brief Function counts readers in library.
+ * @brief Function returns number of readers in library. Counter is kept up to date
+ * incrementally, so it takes constant time.
  *
+ * @param library Library
  * @return Number of readers in library
  */
-int get_readers_in_library_count() {
-    int count = 0;
-    for (int i = 0;i < writers_count + readers_count;i++) {
-        if (in_library[i].kind == READER_KIND) {
-            count++;
-        }
-    }
-    return count;
+int get_readers_in_library_count(struct library *library) {
+    return library->readers_in_library_count;
 }
 
 /*!
- * @brief Prints library and queues state. There are two different of printing - one standard and one for debug mode.
+ * @brief Increments or decrements counter matching thread kind.
  *
- * In standard mode function prints message in format:
+ * @param kind Thread kind (READER_KIND / WRITER_KIND)
+ * @param readers_counter Counter to change for readers
+ * @param writers_counter Counter to change for writers
+ * @param delta Value to add to counter
+ */
+void update_count(int kind, int *readers_counter, int *writers_counter, int delta) {
+    if (kind == READER_KIND) {
+        *readers_counter += delta;
+    } else if (kind == WRITER_KIND) {
+        *writers_counter += delta;
+    }
+}
+
+/*!
+ * @brief Reports library and queues state change. Function is called with mutex locked, so it does not print anything
+ * itself. In standard mode state is pushed to status log and printed by logger thread in format:
  * ReaderQ: readers_in_queue WriterQ: writers_in_queue [ in: R:readers_in_library W:writers_in_library ]
  *
- * In debug mode function prints all threads with theirs numbers - grouped to queue and library.
+ * In debug mode function does nothing - whole state is printed every second by main thread (see print_debug). In
+ * benchmark mode (and with other backends than RW_LOCK_NATIVE or with more than one library) function does nothing as
+ * well.
+ *
+ * @param library Library which state has changed
+ */
+void print(struct library *library) {
+    if (is_status_logged) {
+        status_log_push(get_readers_queue_count(library), get_writers_queue_count(library),
+                        get_readers_in_library_count(library), get_writers_in_library_count(library));
+    }
+    if (is_metrics_run) {
+        metrics_set_library((int) (library - libraries), get_readers_queue_count(library),
+                            get_writers_queue_count(library), get_readers_in_library_count(library),
+                            get_writers_in_library_count(library));
+    }
+}
+
+/*!
+ * @brief Prints library and queues state in debug mode. Function copies state with mutex locked (queue is copied in
+ * order, starting from first thread) and prints the copy after mutex is unlocked, so printing does not block readers
+ * and writers. If there is more than one library, state of every library is printed after "Library number" line.
+ *
+ * Function prints all threads with theirs numbers - grouped to queue and library.
  * Format:
  * Queue (seconds in queue):
- * Reader reader_number (seconds_in_queue) or Writer writer_number (seconds_in_queue)
+ * Reader reader_number (seconds_in_queue, with milliseconds) or Writer writer_number (seconds_in_queue)
  * (...)
  *
  * In library (seconds in library):
  * Writer writer_number (seconds_in_queue) or Reader reader_number (seconds_in_queue)
  * (...)
  */
-void print() {
-    if (is_debug_run == 0) {
-        printf("ReaderQ: %i\t", get_readers_queue_count());
-        printf("WriterQ: %i\t", get_writers_queue_count());
-        printf("[ in: R:%i\t", get_readers_in_library_count());
-        printf("W:%i ]\n", get_writers_in_library_count());
-    } else {
-        int i;
-        for (i = 0;i < 100;i++) {
-            printf("\n");
-        }
-        printf("Queue (seconds in queue):\n");
-        for (i = 0;i < readers_count + writers_count;i++) {
-            switch (queue[i].kind) {
-                case WRITER_KIND:
-                    printf("Writer %i\t", queue[i].id);
-                    printf("(%li)\n", get_timestamp() - queue[i].timestamp);
-                    break;
-                case READER_KIND:
-                    printf("Reader %i\t", queue[i].id);
-                    printf("(%li)\n", get_timestamp() - queue[i].timestamp);
-                    break;
-                default:
-                    break;
-            }
-        }
-        printf("\nIn library (seconds in library):\n");
-        for (i = 0;i < readers_count + writers_count;i++) {
-            switch (in_library[i].kind) {
-                case WRITER_KIND:
-                    printf("Writer %i\t", in_library[i].id);
-                    printf("(%li)\n", get_timestamp() - in_library[i].timestamp);
-                    break;
-                case READER_KIND:
-                    printf("Reader %i\t", in_library[i].id);
-                    printf("(%li)\n", get_timestamp() - in_library[i].timestamp);
-                    break;
-                default:
-                    break;
-            }
+void print_debug() {
+    struct presence *queue_copy = malloc(libraries_count * queue_capacity * sizeof(struct presence));
+    struct presence *in_library_copy = malloc(libraries_count * queue_capacity * sizeof(struct presence));
+    int *queue_copy_sizes = malloc(libraries_count * sizeof(int));
+    int i, library_number;
+
+    for (library_number = 0;library_number < libraries_count;library_number++) {
+        struct library *library = &libraries[library_number];
+        struct presence *library_queue_copy = &queue_copy[library_number * queue_capacity];
+        adaptive_mutex_lock(&library->mutex);
+        queue_copy_sizes[library_number] = library->queue_size;
+        for (i = 0;i < library->queue_size;i++) {
+            library_queue_copy[i] = library->queue[(library->queue_head + i) % queue_capacity];
         }
+        memcpy(&in_library_copy[library_number * queue_capacity], library->in_library,
+               queue_capacity * sizeof(struct presence));
+        adaptive_mutex_unlock(&library->mutex);
     }
-}
 
-/*!
- * @brief Readers thread. It works in endless loop. It waits for signal from its conditional variable and then enters
- * library.
- *
- * @param arg Reader id
- */
-void* reader(void* arg) {
-    int reader_id = *((int *) arg);
-    while (1) {
-        pthread_mutex_lock(&mutex);
-        pthread_cond_wait(&readers_conds[reader_id], &mutex);
-        pthread_mutex_unlock(&mutex);
-        read_books(reader_id);
+    int64_t timestamp = get_timestamp();
+    for (i = 0;i < 100;i++) {
+        printf("\n");
     }
-}
-
-/*!
- * @brief Writers thread. It works in endless loop. It waits for signal from its conditional variable and then enters
- * library.
- *
- * @param arg Writer id
- */
-void* writer(void* arg) {
-    int writer_id = *((int *) arg);
-    while (1) {
-        pthread_mutex_lock(&mutex);
-        pthread_cond_wait(&writers_conds[writer_id], &mutex);
-        pthread_mutex_unlock(&mutex);
-        write_book(writer_id);
+    for (library_number = 0;library_number < libraries_count;library_number++) {
+        if (libraries_count > 1) {
+            printf("%sLibrary %i\n\n", library_number ? "\n" : "", library_number);
+        }
+        print_debug_library(&queue_copy[library_number * queue_capacity], queue_copy_sizes[library_number],
+                            &in_library_copy[library_number * queue_capacity], timestamp);
     }
+
+    free(queue_copy);
+    free(in_library_copy);
+    free(queue_copy_sizes);
 }
 
 /*!
- * @brief Librarians thread. It checks every second who is at first position at queue - if it's reader, librarian waits
- * till there is no writer in library (if there was any). Then it sends signal to reader that he can come in. If there
- * is a writer at first position in queue - librarian waits till everyone leaves library and then sends signal to the
- * writer.
+ * @brief Prints copy of queue and library state of one library in debug mode (see print_debug).
+ *
+ * @param queue_copy Copy of queue (in order, starting from first thread)
+ * @param queue_copy_size Number of threads in queue_copy
+ * @param in_library_copy Copy of presence in library
+ * @param timestamp Timestamp that times in queue and in library are counted to
  */
-void* librarian() {
-    int temp1;
-    int temp2;
-    while (1) {
-        switch (queue[0].kind) {
+void print_debug_library(struct presence *queue_copy, int queue_copy_size, struct presence *in_library_copy,
+                         int64_t timestamp) {
+    int i;
+    printf("Queue (seconds in queue):\n");
+    for (i = 0;i < queue_copy_size;i++) {
+        switch (queue_copy[i].kind) {
+            case WRITER_KIND:
+                printf("Writer %i\t", queue_copy[i].id);
+                printf("(%.3f)\n", (timestamp - queue_copy[i].timestamp) / (double) NANOSECONDS_IN_SECOND);
+                break;
             case READER_KIND:
-                do {
-                    pthread_mutex_lock(&mutex);
-                    temp1 = get_writers_in_library_count();
-                    pthread_mutex_unlock(&mutex);
-                } while (temp1);
-                pthread_cond_broadcast(&readers_conds[queue[0].id]);
+                printf("Reader %i\t", queue_copy[i].id);
+                printf("(%.3f)\n", (timestamp - queue_copy[i].timestamp) / (double) NANOSECONDS_IN_SECOND);
                 break;
+            default:
+                break;
+        }
+    }
+    printf("\nIn library (seconds in library):\n");
+    for (i = 0;i < readers_count + writers_count;i++) {
+        switch (in_library_copy[i].kind) {
             case WRITER_KIND:
-                do {
-                    pthread_mutex_lock(&mutex);
-                    temp1 = get_readers_in_library_count();
-                    temp2 = get_writers_in_library_count();
-                    pthread_mutex_unlock(&mutex);
-                } while (temp1 || temp2);
-                pthread_cond_broadcast(&writers_conds[queue[0].id]);
+                printf("Writer %i\t", in_library_copy[i].id);
+                printf("(%.3f)\n",
+                       (timestamp - in_library_copy[i].timestamp) / (double) NANOSECONDS_IN_SECOND);
+                break;
+            case READER_KIND:
+                printf("Reader %i\t", in_library_copy[i].id);
+                printf("(%.3f)\n",
+                       (timestamp - in_library_copy[i].timestamp) / (double) NANOSECONDS_IN_SECOND);
                 break;
             default:
-                do {
-                    pthread_mutex_lock(&mutex);
-                    temp1 = get_readers_in_library_count();
-                    temp2 = get_writers_in_library_count();
-                    pthread_mutex_unlock(&mutex);
-                } while (temp1 || temp2);
-                pthread_cond_broadcast(&readers_conds[queue[0].id]);
                 break;
         }
-        sleep(1);
     }
 }
 
 /*!
- * @brief Function looks for first empty position in queue and puts there writer or reader. It also sets current
- * timestamp.
- *
- * @param kind Kind of thread that want to get to queue
- * @param id Id of thread that want to get to queue
+ * @brief Merges latency histograms of all readers and all writers and prints p50, p99, p999 and maximum of time spent
+ * in queue and in library for both roles. Histograms are recorded without locks, so mutex is not locked.
  */
-void get_to_queue(int kind, int id) {
-    time_t timestamp = get_timestamp();
-    int first_empty_position = 0;
-    while (queue[first_empty_position].kind != NO_KIND) {
-        first_empty_position++;
-    }
-    queue[first_empty_position].kind = kind;
-    queue[first_empty_position].id = id;
-    queue[first_empty_position].timestamp = timestamp;
+void print_latency() {
+    printf("\n");
+    histogram_print_header();
+    latency_print("Readers", readers_latency, readers_count);
+    latency_print("Writers", writers_latency, writers_count);
+    printf("\n");
 }
 
 /*!
- * @brief Function looks for first empty position in *in_library array and puts there writer or reader. It also sets
- * current timestamp.
+ * @brief Prints benchmark time and number of admissions to library (and admissions per second) of readers and writers.
+ * Admissions are counted from latency histograms (every admission records time spent in queue). Then CPU time and
+ * context switches of process are printed (see throughput_print_resources).
  *
- * @param kind Kind of thread that want to get to library
- * @param id Id of thread that want to get to library
+ * @param elapsed Benchmark time in nanoseconds
  */
-void get_to_library(int kind, int id) {
-    time_t timestamp = get_timestamp();
-    int first_empty_position = 0;
-    while (in_library[first_empty_position].kind != NO_KIND) {
-        first_empty_position++;
-    }
-    in_library[first_empty_position].kind = kind;
-    in_library[first_empty_position].id = id;
-    in_library[first_empty_position].timestamp = timestamp;
+void print_throughput(int64_t elapsed) {
+    printf("Benchmark time: %.3f s, seed: %llu\n", elapsed / (double) NANOSECONDS_IN_SECOND,
+           (unsigned long long) seed);
+    throughput_print_header();
+    throughput_print("Readers", readers_latency, readers_count, elapsed);
+    throughput_print("Writers", writers_latency, writers_count, elapsed);
+    printf("\n");
+    throughput_print_resources();
+    printf("\n");
 }
 
 /*!
- * @brief Function puts at every position in queue presence from next position. Previous last position is overridden
- * with NO_KIND presence.
+ * @brief Prints number of admissions to every library and its share of all admissions (if there is more than one
+ * library), so it can be seen how accesses are spread over libraries.
  */
-void leave_queue() {
-    int i = 0;
-    while (queue[i + 1].kind != NO_KIND && i < 20) {
-        queue[i].kind = queue[i + 1].kind;
-        queue[i].id = queue[i + 1].id;
-        queue[i].timestamp = queue[i + 1].timestamp;
-        i++;
+void print_libraries() {
+    long long admissions = 0;
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        admissions += atomic_load(&libraries[i].admissions_count);
     }
-    queue[i].kind = NO_KIND;
+    printf("%-24s %10s %12s\n", "Library admissions", "count", "percent");
+    for (i = 0;i < libraries_count;i++) {
+        char name[24];
+        long long count = atomic_load(&libraries[i].admissions_count);
+        snprintf(name, sizeof(name), "Library %i", i);
+        printf("%-24s %10lld %12.2f\n", name, count, admissions ? 100.0 * count / admissions : 0.0);
+    }
+    printf("\n");
 }
 
 /*!
- * @brief Looks *in_library array for thread wanting to leave library and overrides it with NO_KIND presence.
- *
- * @param kind Kind of thread that wants to leave library
- * @param id Id of thread that wants to leave library
+ * @brief Prints number of admitted visits and visits that gave up at deadline (and theirs share of all visits) of
+ * readers and writers (deadline mode). Admissions are counted from latency histograms, visits that gave up - by
+ * program or, with other backends than RW_LOCK_NATIVE, by reader-writer library (see rw_library_get_counts).
  */
-void leave_library(int kind, int id) {
-    for (int i = 0;i < readers_count + writers_count;i++) {
-        if (in_library[i].kind == kind && in_library[i].id == id) {
-            in_library[i].kind = NO_KIND;
+void print_deadlines() {
+    long long timeouts[2] = {atomic_load(&readers_timeouts_count), atomic_load(&writers_timeouts_count)};
+    struct latency_histograms *latencies[2] = {readers_latency, writers_latency};
+    int counts[2] = {readers_count, writers_count};
+    const char *roles[2] = {"Readers", "Writers"};
+    printf("%-24s %10s %12s %12s\n", "Deadline visits", "admitted", "timed out", "percent");
+    int role, i;
+    struct rw_library_counts library_counts;
+    for (i = 0;i < libraries_count && lock_backend != RW_LOCK_NATIVE;i++) {
+        rw_library_get_counts(libraries[i].rw_lock.library, &library_counts);
+        timeouts[0] += library_counts.readers_gave_up;
+        timeouts[1] += library_counts.writers_gave_up;
+    }
+    for (role = 0;role < 2;role++) {
+        long long admissions = 0;
+        for (i = 0;i < counts[role];i++) {
+            admissions += (long long) histogram_count(&latencies[role][i].queue_wait);
+        }
+        printf("%-24s %10lld %12lld %12.2f\n", roles[role], admissions, timeouts[role],
+               admissions + timeouts[role] ? 100.0 * timeouts[role] / (admissions + timeouts[role]) : 0.0);
+    }
+    printf("\n");
+}
+
+/*!
+ * @brief Prints number of optimistic reads, number of theirs retries and average number of retries per read (seqlock
+ * mode). Reads are counted from latency histograms of readers.
+ */
+void print_seqlock() {
+    long long reads = 0;
+    long long retries = atomic_load(&seqlock_retries_count);
+    for (int i = 0;i < readers_count;i++) {
+        reads += (long long) histogram_count(&readers_latency[i].queue_wait);
+    }
+    printf("%-24s %10s %12s %12s\n", "Optimistic reads", "reads", "retries", "per read");
+    printf("%-24s %10lld %12lld %12.4f\n", "Readers", reads, retries, reads ? (double) retries / reads : 0.0);
+    printf("\n");
+}
+
+/*!
+ * @brief Readers thread. It works until signal_flag is reset. It waits on its conditional variable till librarian lets
+ * it in to library (sets its granted flag). Being already in library, reader takes admission (see take_admission),
+ * records time spent in queue and then reads books. In trace mode reader gets to queue only at arrival time of its
+ * next record (see wait_for_arrival). If there is more than one library, reader chooses library before every visit
+ * (see choose_library) and gets to its queue (see arrive_at_library). In deadline mode reader that is not let in before
+ * its deadline gives up the visit (see wait_for_admission). In seqlock mode reader does not wait in queue at all - it
+ * reads optimistically (see read_optimistically).
+ *
+ * @param arg Reader id
+ * @return NULL
+ */
+void* reader(void* arg) {
+    int reader_id = *((int *) arg);
+    struct rng rng;
+    rng_seed(&rng, seed, reader_id);
+    if (lock_backend != RW_LOCK_NATIVE) {
+        int64_t backoff = 0;
+        while (signal_flag) {
+            read_with_lock(choose_library(&rng), reader_id, &rng, &backoff);
+        }
+        return NULL;
+    }
+    int record = is_trace_run ? trace_first(&trace, TRACE_READER, reader_id) : -1;
+    int64_t arrived_at = 0;
+    int64_t backoff = 0;
+    while (signal_flag) {
+        int64_t reading_time = is_trace_run ? wait_for_arrival(&record, &arrived_at) :
+                               rng_time(&rng, time_distribution, min_reading_time, max_reading_time);
+        if (reading_time < 0) {
+            break;
+        }
+        struct library *library = choose_library(&rng);
+        if (is_seqlock_run) {
+            read_optimistically(library, reader_id, reading_time, arrived_at);
+            continue;
+        }
+        adaptive_mutex_lock(&library->mutex);
+        if (is_queued_on_arrival) {
+            arrive_at_library(library, READER_KIND, reader_id, arrived_at);
+        }
+        int is_admitted = wait_for_admission(library, READER_KIND, reader_id);
+        if (!signal_flag) {
+            adaptive_mutex_unlock(&library->mutex);
             break;
         }
+        if (!is_admitted) {
+            adaptive_mutex_unlock(&library->mutex);
+            back_off(&backoff);
+            continue;
+        }
+        backoff = 0;
+        int64_t queue_wait = take_admission(library, READER_KIND, reader_id);
+        adaptive_mutex_unlock(&library->mutex);
+        histogram_record(&readers_latency[reader_id].queue_wait, queue_wait);
+        read_books(library, reader_id, reading_time);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Writers thread. It works until signal_flag is reset. It waits on its conditional variable till librarian lets
+ * it in to library (sets its granted flag), records time spent in queue and then writes a book. In trace mode writer
+ * gets to queue only at arrival time of its next record (see wait_for_arrival). If there is more than one library,
+ * writer chooses library before every visit (see choose_library) and gets to its queue (see arrive_at_library). In
+ * deadline mode writer that is not let in before its deadline gives up the visit (see wait_for_admission).
+ *
+ * @param arg Writer id
+ * @return NULL
+ */
+void* writer(void* arg) {
+    int writer_id = *((int *) arg);
+    struct rng rng;
+    rng_seed(&rng, seed, readers_count + writer_id);
+    if (lock_backend != RW_LOCK_NATIVE) {
+        int64_t backoff = 0;
+        while (signal_flag) {
+            write_with_lock(choose_library(&rng), writer_id, &rng, &backoff);
+        }
+        return NULL;
+    }
+    int record = is_trace_run ? trace_first(&trace, TRACE_WRITER, writer_id) : -1;
+    int64_t arrived_at = 0;
+    int64_t backoff = 0;
+    while (signal_flag) {
+        int64_t writing_time = is_trace_run ? wait_for_arrival(&record, &arrived_at) :
+                               rng_time(&rng, time_distribution, min_writing_time, max_writing_time);
+        if (writing_time < 0) {
+            break;
+        }
+        struct library *library = choose_library(&rng);
+        adaptive_mutex_lock(&library->mutex);
+        if (is_queued_on_arrival) {
+            arrive_at_library(library, WRITER_KIND, writer_id, arrived_at);
+        }
+        int is_admitted = wait_for_admission(library, WRITER_KIND, writer_id);
+        if (!signal_flag) {
+            adaptive_mutex_unlock(&library->mutex);
+            break;
+        }
+        if (!is_admitted) {
+            adaptive_mutex_unlock(&library->mutex);
+            back_off(&backoff);
+            continue;
+        }
+        backoff = 0;
+        int64_t queue_wait = take_admission(library, WRITER_KIND, writer_id);
+        adaptive_mutex_unlock(&library->mutex);
+        histogram_record(&writers_latency[writer_id].queue_wait, queue_wait);
+        write_book(library, writer_id, writing_time);
     }
+    return NULL;
 }
 
 /*!
- * @brief Function symbolises entering library by a writer and writing a book. It takes off first thread from queue
- * and puts writer to *in_library array. After that function sleeps for some random time (by default 5-15 seconds, it
- * can be changed by main function arguments) and leaves library (removes itself from *in_library array and gets back
- * to queue).
+ * @brief Librarian. It is not a thread - function is called (with mutex locked) every time state of queue or library
+ * changes. It checks who is at first position at queue - if it's reader and there is no writer in library, reader is
+ * let in (in batch admission mode - all readers up to first writer in queue are let in). If there is a writer at first
+ * position in queue and library is empty, writer is let in. Thread that is let in is taken off from queue, put to
+ * library and its granted flag is set before it is woken up (see wake_up).
  *
+ * @param library Library which queue is checked
+ */
+void librarian(struct library *library) {
+    if (!library->queue_size) {
+        return;
+    }
+    struct presence *queue = library->queue;
+    int id = queue[library->queue_head].id;
+    switch (queue[library->queue_head].kind) {
+        case READER_KIND:
+            if (!get_writers_in_library_count(library)) {
+                do {
+                    id = queue[library->queue_head].id;
+                    leave_queue(library);
+                    get_to_library(library, READER_KIND, id);
+                    count_admission(library);
+                    readers_state[id].granted = 1;
+                    wake_up(READER_KIND, id);
+                } while (is_batch_admission && library->queue_size && queue[library->queue_head].kind == READER_KIND);
+                print(library);
+            }
+            break;
+        case WRITER_KIND:
+            if (!get_readers_in_library_count(library) && !get_writers_in_library_count(library)) {
+                leave_queue(library);
+                get_to_library(library, WRITER_KIND, id);
+                count_admission(library);
+                writers_state[id].granted = 1;
+                wake_up(WRITER_KIND, id);
+                print(library);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/*!
+ * @brief Function puts writer or reader at the end of queue (position right after last thread in ring buffer). It also
+ * sets current timestamp (in queue and in thread's state) and thread's position in queue. If all positions are taken
+ * (possible only in deadline mode), positions left by threads that gave up are removed first (see compact_queue).
+ *
+ * @param library Library which queue thread gets to
+ * @param kind Kind of thread that want to get to queue
+ * @param id Id of thread that want to get to queue
+ * @return Timestamp of getting to queue
+ */
+int64_t get_to_queue(struct library *library, int kind, int id) {
+    int64_t timestamp = get_timestamp();
+    if (library->queue_size == queue_capacity) {
+        compact_queue(library);
+    }
+    int queue_position = (library->queue_head + library->queue_size) % queue_capacity;
+    struct presence *position = &library->queue[queue_position];
+    position->kind = kind;
+    position->id = id;
+    position->timestamp = timestamp;
+    library->queue_size++;
+    update_count(kind, &library->readers_queue_count, &library->writers_queue_count, 1);
+    struct thread_state *state = get_thread_state(kind, id);
+    state->enqueued_at = timestamp;
+    state->queue_position = queue_position;
+    if (kind == WRITER_KIND) {
+        metrics_writer_queued(id, timestamp);
+    }
+    return timestamp;
+}
+
+/*!
+ * @brief Function gets position in *in_library array of library assigned to thread. Readers have positions from 0 to
+ * readers_count - 1, writers have following positions.
+ *
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ * @return Position in *in_library array
+ */
+int get_library_slot(int kind, int id) {
+    return kind == READER_KIND ? id : readers_count + id;
+}
+
+/*!
+ * @brief Function puts writer or reader to its position in *in_library array. It also sets current timestamp.
+ *
+ * @param library Library that thread gets to
+ * @param kind Kind of thread that want to get to library
+ * @param id Id of thread that want to get to library
+ */
+void get_to_library(struct library *library, int kind, int id) {
+    int64_t timestamp = get_timestamp();
+    struct presence *slot = &library->in_library[get_library_slot(kind, id)];
+    slot->kind = kind;
+    slot->id = id;
+    slot->timestamp = timestamp;
+    update_count(kind, &library->readers_in_library_count, &library->writers_in_library_count, 1);
+    if (kind == WRITER_KIND) {
+        metrics_writer_queued(id, 0);
+    }
+    if (kind != library->phase_kind) {
+        library->phase_kind = kind;
+        metrics_count_phase_switch(get_metrics_role(kind));
+    }
+}
+
+/*!
+ * @brief Function takes off first thread from queue - it overrides its position with NO_KIND presence and moves
+ * queue_head to next thread (skipping positions left by threads that gave up, see drop_given_up).
+ *
+ * @param library Library which queue first thread leaves
+ */
+void leave_queue(struct library *library) {
+    struct presence *first = &library->queue[library->queue_head];
+    update_count(first->kind, &library->readers_queue_count, &library->writers_queue_count, -1);
+    first->kind = NO_KIND;
+    library->queue_head = (library->queue_head + 1) % queue_capacity;
+    library->queue_size--;
+    drop_given_up(library);
+}
+
+/*!
+ * @brief Function removes positions left by threads that gave up (NO_KIND presences) from the beginning and from the
+ * end of queue, so first and last position of queue always hold a thread.
+ *
+ * @param library Library which queue is trimmed
+ */
+void drop_given_up(struct library *library) {
+    while (library->queue_size && library->queue[library->queue_head].kind == NO_KIND) {
+        library->queue_head = (library->queue_head + 1) % queue_capacity;
+        library->queue_size--;
+    }
+    while (library->queue_size &&
+           library->queue[(library->queue_head + library->queue_size - 1) % queue_capacity].kind == NO_KIND) {
+        library->queue_size--;
+    }
+}
+
+/*!
+ * @brief Function moves threads in queue to following positions from queue_head, removing positions left by threads
+ * that gave up, and updates theirs queue positions (deadline mode). It is called only when all positions are taken -
+ * there are at most queue_capacity / 2 threads, so at least half of positions is freed and cost of moving is spread
+ * over visits that left them.
+ *
+ * @param library Library which queue is compacted
+ */
+void compact_queue(struct library *library) {
+    int size = 0;
+    int i;
+    for (i = 0;i < library->queue_size;i++) {
+        struct presence *from = &library->queue[(library->queue_head + i) % queue_capacity];
+        if (from->kind == NO_KIND) {
+            continue;
+        }
+        int queue_position = (library->queue_head + size++) % queue_capacity;
+        if (&library->queue[queue_position] != from) {
+            library->queue[queue_position] = *from;
+            from->kind = NO_KIND;
+        }
+        get_thread_state(library->queue[queue_position].kind, library->queue[queue_position].id)->queue_position =
+                queue_position;
+    }
+    library->queue_size = size;
+}
+
+/*!
+ * @brief Function delays next arrival of thread that gave up its visit at deadline (deadline mode), so it does not get
+ * back to queue at once and lock mutex of library again and again while it can not be let in (with deadline 0 it
+ * would give up at once every time). Thread sleeps DEADLINE_BACKOFF_TIME, doubled with every next visit given up in a
+ * row, up to DEADLINE_MAX_BACKOFF_TIME - backoff is reset to 0 by caller when thread is let in. In trace mode arrivals
+ * are given by trace, so function does nothing.
+ *
+ * @param backoff Last backoff time of thread in nanoseconds (0 if its last visit was let in), updated by function
+ */
+void back_off(int64_t *backoff) {
+    if (is_trace_run) {
+        return;
+    }
+    *backoff = *backoff ? *backoff * 2 : DEADLINE_BACKOFF_TIME;
+    if (*backoff > DEADLINE_MAX_BACKOFF_TIME) {
+        *backoff = DEADLINE_MAX_BACKOFF_TIME;
+    }
+    sleep_interruptible(*backoff);
+}
+
+/*!
+ * @brief Function takes thread whose deadline passed off from queue (deadline mode). Its position is overridden with
+ * NO_KIND presence - it is found by thread's queue position, so queue is not searched. If thread was first in queue,
+ * following threads may be let in, so librarian is called. Mutex of library has to be locked.
+ *
+ * @param library Library which queue thread leaves
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ */
+void give_up(struct library *library, int kind, int id) {
+    library->queue[get_thread_state(kind, id)->queue_position].kind = NO_KIND;
+    update_count(kind, &library->readers_queue_count, &library->writers_queue_count, -1);
+    drop_given_up(library);
+    if (kind == WRITER_KIND) {
+        metrics_writer_queued(id, 0);
+    }
+    atomic_fetch_add_explicit(kind == READER_KIND ? &readers_timeouts_count : &writers_timeouts_count, 1,
+                              memory_order_relaxed);
+    print(library);
+    librarian(library);
+}
+
+/*!
+ * @brief Overrides position in *in_library array assigned to thread wanting to leave library with NO_KIND presence.
+ *
+ * @param library Library that thread leaves
+ * @param kind Kind of thread that wants to leave library
+ * @param id Id of thread that wants to leave library
+ */
+void leave_library(struct library *library, int kind, int id) {
+    struct presence *slot = &library->in_library[get_library_slot(kind, id)];
+    if (slot->kind == kind) {
+        slot->kind = NO_KIND;
+        update_count(kind, &library->readers_in_library_count, &library->writers_in_library_count, -1);
+    }
+}
+
+/*!
+ * @brief Function symbolises writing a book by a writer that was let in to library by librarian. Function spends
+ * given time in library (see spend_time) and gets back to queue (see return_to_queue). Time spent in library is
+ * recorded in writer's latency histogram.
+ *
+ * @param library Library that writer was let in to
  * @param writer_id Writer thread id
+ * @param writing_time Time (in nanoseconds) spent in library - random (by default 5-15 seconds, it can be changed by
+ * main function arguments) or hold time of trace record
  */
-void write_book(int writer_id) {
-    pthread_mutex_lock( &mutex );
+void write_book(struct library *library, int writer_id, int64_t writing_time) {
+    if (is_seqlock_run) {
+        seqlock_write_begin(&library->seqlock, writer_id);
+    }
+    spend_time(writing_time);
+    if (is_seqlock_run) {
+        seqlock_write_end(&library->seqlock);
+    }
 
-    leave_queue();
-    get_to_library(WRITER_KIND, writer_id);
+    adaptive_mutex_lock( &library->mutex );
+    int64_t in_library_time = return_to_queue(library, WRITER_KIND, writer_id);
+    adaptive_mutex_unlock( &library->mutex );
 
-    print();
+    histogram_record(&writers_latency[writer_id].in_library, in_library_time);
+}
 
-    pthread_mutex_unlock( &mutex );
+/*!
+ * @brief Function symbolises reading books by a reader that was let in to library by librarian. Function spends
+ * given time in library (see spend_time) and gets back to queue (see return_to_queue). Time spent in library is
+ * recorded in reader's latency histogram.
+ *
+ * @param library Library that reader was let in to
+ * @param reader_id Reader thread id
+ * @param reading_time Time (in nanoseconds) spent in library - random (by default 0-5 seconds, it can be changed by
+ * main function arguments) or hold time of trace record
+ */
+void read_books(struct library *library, int reader_id, int64_t reading_time) {
+    spend_time(reading_time);
 
-    sleep(get_random(min_writing_time, max_writing_time));
+    adaptive_mutex_lock( &library->mutex );
+    int64_t in_library_time = return_to_queue(library, READER_KIND, reader_id);
+    adaptive_mutex_unlock( &library->mutex );
 
-    pthread_mutex_lock( &mutex );
+    histogram_record(&readers_latency[reader_id].in_library, in_library_time);
+}
 
-    leave_library(WRITER_KIND, writer_id);
-    get_to_queue(WRITER_KIND, writer_id);
+/*!
+ * @brief Function gets state of reader or writer.
+ *
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ * @return Thread state (from *readers_state or *writers_state)
+ */
+struct thread_state* get_thread_state(int kind, int id) {
+    return kind == READER_KIND ? &readers_state[id] : &writers_state[id];
+}
 
-    print();
+/*!
+ * @brief Function gets role of thread kind used by metrics.
+ *
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @return Role (METRICS_READER / METRICS_WRITER)
+ */
+int get_metrics_role(int kind) {
+    return kind == READER_KIND ? METRICS_READER : METRICS_WRITER;
+}
 
-    pthread_mutex_unlock( &mutex );
+/*!
+ * @brief Function takes admission given by librarian to thread that is already in library - it resets granted flag
+ * and, if thread is a reader, calls librarian, so next thread in queue can be let in (not needed in batch admission
+ * mode - following readers were let in together). Mutex of library has to be locked.
+ *
+ * @param library Library that thread was let in to
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ * @return Time (in nanoseconds) spent by thread in queue
+ */
+int64_t take_admission(struct library *library, int kind, int id) {
+    struct thread_state *state = get_thread_state(kind, id);
+    state->granted = 0;
+    int64_t queue_wait = library->in_library[get_library_slot(kind, id)].timestamp - state->enqueued_at;
+    if (kind == READER_KIND && !is_batch_admission) {
+        librarian(library);
+    }
+    return queue_wait;
 }
 
 /*!
- * @brief Function symbolises entering library by a reader and reading books. It takes off first thread from queue
- * and puts reader to *in_library array. After that function sleeps for some random time (by default 0-5 seconds, it can
- * be changed by main function arguments) and leaves library (removes itself from *in_library array and gets back to
- * queue).
+ * @brief Function symbolises leaving library - thread removes itself from *in_library array and gets back to queue (if
+ * is_queued_on_arrival is set, thread gets to queue at its next arrival, see arrive_at_library). Then it calls
+ * librarian, so next thread can be let in. Mutex of library has to be locked.
  *
+ * @param library Library that thread leaves
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ * @return Time (in nanoseconds) spent by thread in library
+ */
+int64_t return_to_queue(struct library *library, int kind, int id) {
+    int64_t entered_at = library->in_library[get_library_slot(kind, id)].timestamp;
+    leave_library(library, kind, id);
+    int64_t left_at = is_queued_on_arrival ? get_timestamp() : get_to_queue(library, kind, id);
+
+    print(library);
+
+    librarian(library);
+
+    return left_at - entered_at;
+}
+
+/*!
+ * @brief Function puts thread that has arrived at library at the end of its queue (if is_queued_on_arrival is set,
+ * see return_to_queue) and calls librarian. In trace mode queue timestamp of thread is set to its arrival time, so
+ * late thread's wait is counted from arrival, not from the moment it got to queue. Mutex of library has to be locked.
+ *
+ * @param library Library that thread has arrived at
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ * @param arrived_at Arrival time of trace record (0 if thread has arrived now)
+ */
+void arrive_at_library(struct library *library, int kind, int id, int64_t arrived_at) {
+    get_to_queue(library, kind, id);
+    if (arrived_at) {
+        get_thread_state(kind, id)->enqueued_at = arrived_at;
+        if (kind == WRITER_KIND) {
+            metrics_writer_queued(id, arrived_at);
+        }
+    }
+    print(library);
+    librarian(library);
+}
+
+/*!
+ * @brief Function waits on thread's conditional variable till librarian lets thread in to library (sets its granted
+ * flag) or signal_flag is reset. In deadline mode thread waits till deadline - enqueued_at + deadline_time, measured
+ * with monotonic clock like conditional variables of threads - and then gives up (see give_up). Mutex of library has
+ * to be locked.
+ *
+ * @param library Library which queue thread waits in
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ * @return 1 if thread was let in, 0 if it gave up (or signal_flag was reset)
+ */
+int wait_for_admission(struct library *library, int kind, int id) {
+    struct thread_state *state = get_thread_state(kind, id);
+    int64_t deadline = state->enqueued_at + deadline_time;
+    struct timespec deadline_time_spec = {deadline / NANOSECONDS_IN_SECOND, deadline % NANOSECONDS_IN_SECOND};
+    if (!state->granted && signal_flag) {
+        metrics_count_wait(get_metrics_role(kind));
+    }
+    while (!state->granted && signal_flag) {
+        if (!is_deadline_run) {
+            pthread_cond_wait(&state->cond, &library->mutex.mutex);
+        } else if (get_timestamp() >= deadline ||
+                   pthread_cond_timedwait(&state->cond, &library->mutex.mutex, &deadline_time_spec) == ETIMEDOUT) {
+            if (!state->granted) {
+                give_up(library, kind, id);
+                return 0;
+            }
+        }
+    }
+    return state->granted;
+}
+
+/*!
+ * @brief Function symbolises optimistic reading of library's book (seqlock mode). Reader takes sequence snapshot,
+ * copies the book and spends given time reading it (see spend_time), then checks sequence again - if writer was
+ * writing in the meantime, reading is retried. Reader does not lock mutex and does not write anything shared (only
+ * number of retries, and only if there were any). Time from arrival to start of successful reading is recorded as
+ * queue wait and time of successful reading as time spent in library.
+ *
+ * @param library Library which book is read
  * @param reader_id Reader thread id
+ * @param reading_time Time (in nanoseconds) of reading - random or hold time of trace record
+ * @param arrived_at Arrival time of trace record (0 if reader has arrived now)
+ */
+void read_optimistically(struct library *library, int reader_id, int64_t reading_time, int64_t arrived_at) {
+    long long book[SEQLOCK_BOOK_WORDS];
+    int64_t arrival = arrived_at ? arrived_at : get_timestamp();
+    int64_t read_at;
+    long long retries = -1;
+    unsigned int sequence;
+    do {
+        retries++;
+        wait_for_writing(library);
+        sequence = seqlock_read_begin(&library->seqlock);
+        read_at = get_timestamp();
+        seqlock_read_book(&library->seqlock, book);
+        spend_time(reading_time);
+    } while (signal_flag && seqlock_read_retry(&library->seqlock, sequence));
+    if (!signal_flag) {
+        return;
+    }
+    if (retries) {
+        atomic_fetch_add_explicit(&seqlock_retries_count, retries, memory_order_relaxed);
+    }
+    histogram_record(&readers_latency[reader_id].queue_wait, read_at - arrival);
+    histogram_record(&readers_latency[reader_id].in_library, get_timestamp() - read_at);
+    count_admission(library);
+}
+
+/*!
+ * @brief Function waits till no writer is writing the book of library (sequence is even) or signal_flag is reset. In
+ * benchmark mode it yields processor between checks, in standard mode it sleeps SEQLOCK_BACKOFF_TIME (writers write
+ * for seconds there).
+ *
+ * @param library Library which book is read
  */
-void read_books(int reader_id) {
-    pthread_mutex_lock( &mutex );
-    leave_queue();
-    get_to_library(READER_KIND, reader_id);
+void wait_for_writing(struct library *library) {
+    while (signal_flag && (seqlock_read_begin(&library->seqlock) & 1)) {
+        if (is_bench_run) {
+            sched_yield();
+        } else {
+            sleep_interruptible(SEQLOCK_BACKOFF_TIME);
+        }
+    }
+}
 
-    print();
+/*!
+ * @brief Function chooses library for next visit of reader or writer - uniformly or from Zipf distribution (see
+ * libraries_weights). If there is only one library, no random number is drawn, so times drawn with given seed do not
+ * change.
+ *
+ * @param rng Random number generator of reader or writer
+ * @return Library
+ */
+struct library* choose_library(struct rng *rng) {
+    if (libraries_count == 1) {
+        return &libraries[0];
+    }
+    if (libraries_weights) {
+        return &libraries[rng_pick(rng, libraries_weights, libraries_count)];
+    }
+    return &libraries[rng_below(rng, libraries_count)];
+}
 
-    pthread_mutex_unlock( &mutex );
+/*!
+ * @brief Function waits for next arrival of reader or writer in trace mode. It sleeps till arrival time of thread's
+ * record, then thread gets to queue of library it has chosen (see arrive_at_library). Thread that has replayed all its
+ * records gets -1 - the last one sends SIGTERM to process, so program stops the same way as after Ctrl+C.
+ *
+ * @param record Position of thread's next record in trace (it is moved to following record)
+ * @param arrived_at Arrival time of record to set
+ * @return Time (in nanoseconds) thread spends in library, -1 if there are no more records or signal_flag is reset
+ */
+int64_t wait_for_arrival(int *record, int64_t *arrived_at) {
+    if (*record < 0) {
+        if (trace_finish(&trace)) {
+            kill(getpid(), SIGTERM);
+        }
+        return -1;
+    }
+    struct trace_record *next = &trace.records[*record];
+    *record = next->next;
+    int64_t arrival = trace_started_at + next->timestamp;
+    int64_t now = get_timestamp();
+    if (arrival > now) {
+        sleep_interruptible(arrival - now);
+    }
+    if (!signal_flag) {
+        return -1;
+    }
+    trace_count(&trace, arrival < now);
+    *arrived_at = arrival;
+    return next->hold;
+}
 
-    sleep(get_random(min_reading_time, max_reading_time));
+/*!
+ * @brief Function wakes up thread let in by librarian - it signals conditional variable assigned to thread or, in task
+ * mode, submits thread's task if it is parked. Mutex has to be locked.
+ *
+ * @param kind Kind of thread (READER_KIND / WRITER_KIND)
+ * @param id Id of thread
+ */
+void wake_up(int kind, int id) {
+    if (!is_task_run) {
+        pthread_cond_signal(&get_thread_state(kind, id)->cond);
+        return;
+    }
+    struct client_task *client = kind == READER_KIND ? &readers_tasks[id] : &writers_tasks[id];
+    if (client->parked) {
+        client->parked = 0;
+        task_pool_submit(&client->task);
+    }
+}
 
-    pthread_mutex_lock( &mutex );
+/*!
+ * @brief Function allocates readers and writers tasks and starts task pool (task mode). All tasks are parked - they
+ * are in queue, so librarian submits them when it lets them in.
+ */
+void start_tasks() {
+    readers_tasks = malloc(readers_count * sizeof(struct client_task));
+    writers_tasks = malloc(writers_count * sizeof(struct client_task));
+    int i;
+    for (i = 0;i < readers_count + writers_count;i++) {
+        int kind = i < readers_count ? READER_KIND : WRITER_KIND;
+        int id = kind == READER_KIND ? i : i - readers_count;
+        struct client_task *client = kind == READER_KIND ? &readers_tasks[id] : &writers_tasks[id];
+        client->task.run = run_client_task;
+        client->kind = kind;
+        client->id = id;
+        client->step = CLIENT_WAITING;
+        client->parked = 1;
+        rng_seed(&client->rng, seed, i);
+    }
+    task_pool_start(task_workers, readers_count + writers_count, pin_mode);
+}
 
-    leave_library(READER_KIND, reader_id);
-    get_to_queue(READER_KIND, reader_id);
+/*!
+ * @brief Reader or writer task step (task mode). It works like reader and writer threads, but it never blocks worker
+ * thread: thread whose time in library passed gets back to queue, then - if librarian let it in (granted flag is set)
+ * - it takes admission and enters library, otherwise task is parked till librarian wakes it up (see wake_up). Time
+ * in library is spent in timers heap of task pool (in benchmark mode worker spins). Task mode works with one library
+ * only.
+ *
+ * @param task Reader or writer task
+ */
+void run_client_task(struct task *task) {
+    struct client_task *client = (struct client_task *) task;
+    struct library *library = &libraries[0];
+    struct latency_histograms *latency = client->kind == READER_KIND ? &readers_latency[client->id] :
+                                         &writers_latency[client->id];
+    adaptive_mutex_lock(&library->mutex);
+    while (signal_flag) {
+        if (client->step == CLIENT_IN_LIBRARY) {
+            int64_t in_library_time = return_to_queue(library, client->kind, client->id);
+            client->step = CLIENT_WAITING;
+            adaptive_mutex_unlock(&library->mutex);
+            histogram_record(&latency->in_library, in_library_time);
+            adaptive_mutex_lock(&library->mutex);
+            continue;
+        }
+        if (!get_thread_state(client->kind, client->id)->granted) {
+            client->parked = 1;
+            metrics_count_wait(get_metrics_role(client->kind));
+            break;
+        }
+        int64_t queue_wait = take_admission(library, client->kind, client->id);
+        client->step = CLIENT_IN_LIBRARY;
+        adaptive_mutex_unlock(&library->mutex);
+        histogram_record(&latency->queue_wait, queue_wait);
+        int64_t duration = client->kind == READER_KIND ?
+                           rng_time(&client->rng, time_distribution, min_reading_time, max_reading_time) :
+                           rng_time(&client->rng, time_distribution, min_writing_time, max_writing_time);
+        if (!is_bench_run) {
+            task_pool_submit_at(task, get_timestamp() + duration);
+            return;
+        }
+        spend_time(duration);
+        adaptive_mutex_lock(&library->mutex);
+    }
+    adaptive_mutex_unlock(&library->mutex);
+}
 
-    print();
+/*!
+ * @brief Function symbolises reading books by a reader when lock_backend is not RW_LOCK_NATIVE. Reader locks rw_lock
+ * for reading (in deadline mode only before its deadline - if it gives up, it backs off before next visit), spends some
+ * random time in library and unlocks it. Time spent waiting for lock and holding it is recorded in reader's
+ * latency histograms. Library state is not kept, so nothing is printed.
+ *
+ * @param library Library which rw_lock is locked
+ * @param reader_id Reader thread id
+ * @param rng Random number generator of reader thread
+ * @param backoff Backoff time of reader after its last visit (deadline mode, see back_off)
+ */
+void read_with_lock(struct library *library, int reader_id, struct rng *rng, int64_t *backoff) {
+    int64_t enqueued_at = get_timestamp();
+    int64_t deadline = enqueued_at + deadline_time;
+    struct timespec deadline_time_spec = {deadline / NANOSECONDS_IN_SECOND, deadline % NANOSECONDS_IN_SECOND};
+    int result = !is_deadline_run ? rw_lock_read_lock(&library->rw_lock) :
+                 rw_lock_timed_read_lock(&library->rw_lock, deadline_time ? &deadline_time_spec : NULL);
+    if (result) {
+        if (result != ECANCELED) {
+            back_off(backoff);
+        }
+        return;
+    }
+    *backoff = 0;
+    int64_t entered_at = get_timestamp();
+    count_admission(library);
+    spend_time(rng_time(rng, time_distribution, min_reading_time, max_reading_time));
+    int64_t left_at = get_timestamp();
+    rw_lock_read_unlock(&library->rw_lock);
+    histogram_record(&readers_latency[reader_id].queue_wait, entered_at - enqueued_at);
+    histogram_record(&readers_latency[reader_id].in_library, left_at - entered_at);
+}
 
-    pthread_mutex_unlock( &mutex );
+/*!
+ * @brief Function symbolises writing a book by a writer when lock_backend is not RW_LOCK_NATIVE. Writer locks rw_lock
+ * for writing (in deadline mode only before its deadline - if it gives up, it backs off before next visit), spends some
+ * random time in library and unlocks it. Time spent waiting for lock and holding it is recorded in writer's
+ * latency histograms. Library state is not kept, so nothing is printed.
+ *
+ * @param library Library which rw_lock is locked
+ * @param writer_id Writer thread id
+ * @param rng Random number generator of writer thread
+ * @param backoff Backoff time of writer after its last visit (deadline mode, see back_off)
+ */
+void write_with_lock(struct library *library, int writer_id, struct rng *rng, int64_t *backoff) {
+    int64_t enqueued_at = get_timestamp();
+    int64_t deadline = enqueued_at + deadline_time;
+    struct timespec deadline_time_spec = {deadline / NANOSECONDS_IN_SECOND, deadline % NANOSECONDS_IN_SECOND};
+    int result = !is_deadline_run ? rw_lock_write_lock(&library->rw_lock) :
+                 rw_lock_timed_write_lock(&library->rw_lock, deadline_time ? &deadline_time_spec : NULL);
+    if (result) {
+        if (result != ECANCELED) {
+            back_off(backoff);
+        }
+        return;
+    }
+    *backoff = 0;
+    int64_t entered_at = get_timestamp();
+    count_admission(library);
+    spend_time(rng_time(rng, time_distribution, min_writing_time, max_writing_time));
+    int64_t left_at = get_timestamp();
+    rw_lock_write_unlock(&library->rw_lock);
+    histogram_record(&writers_latency[writer_id].queue_wait, entered_at - enqueued_at);
+    histogram_record(&writers_latency[writer_id].in_library, left_at - entered_at);
 }
 
 /*!
-* @brief Function initialises *queue and *in_library arrays.
+* @brief Function initialises *queue and *in_library arrays of every library and puts all threads to queue of the first
+* library (if is_queued_on_arrival is set, queues stay empty till threads arrive).
 */
 void init_queue() {
-    int i;
-    for (i = 0;i < readers_count;i++) {
-        get_to_queue(READER_KIND, i);
-        in_library[i].kind = NO_KIND;
+    int i, library_number;
+    for (library_number = 0;library_number < libraries_count;library_number++) {
+        for (i = 0;i < queue_capacity;i++) {
+            libraries[library_number].in_library[i].kind = NO_KIND;
+        }
+    }
+    if (is_queued_on_arrival) {
+        return;
+    }
+    for (i = 0;i < readers_count && !is_seqlock_run;i++) {
+        get_to_queue(&libraries[0], READER_KIND, i);
+    }
+    for (i = 0;i < writers_count;i++) {
+        get_to_queue(&libraries[0], WRITER_KIND, i);
+    }
+}
+
+/*!
+ * @brief Function symbolises time spent in library. In benchmark mode it spins (reading monotonic clock) for given
+ * time, so throughput is limited only by synchronization and not by sleep granularity - 0 means no work at all. In
+ * standard mode it sleeps (see sleep_interruptible).
+ *
+ * @param duration Time in nanoseconds
+ */
+void spend_time(int64_t duration) {
+    if (!is_bench_run) {
+        sleep_interruptible(duration);
+        return;
     }
-    for (i = readers_count;i < writers_count + readers_count;i++) {
-        get_to_queue(WRITER_KIND, i - readers_count);
-        in_library[i].kind = NO_KIND;
+    if (duration) {
+        int64_t deadline = get_timestamp() + duration;
+        while (signal_flag && get_timestamp() < deadline) {
+            continue;
+        }
     }
 }
 
 /*!
- * @brief Function gets timestamp from system time.
+ * @brief Function counts admission to library if ops_limit is set (atomically, so it does not need mutex and can be
+ * used by every backend). When ops_limit is reached, SIGTERM is sent to process, so main thread stops program the same
+ * way as after Ctrl+C. If there is more than one library, admission is counted in library too (see print_libraries).
  *
- * @return Timestamp
+ * @param library Library that thread is let in to
  */
-time_t get_timestamp() {
-    return time(NULL);
+void count_admission(struct library *library) {
+    if (libraries_count > 1) {
+        atomic_fetch_add_explicit(&library->admissions_count, 1, memory_order_relaxed);
+    }
+    if (ops_limit && atomic_fetch_add_explicit(&admissions_count, 1, memory_order_relaxed) + 1 == ops_limit) {
+        kill(getpid(), SIGTERM);
+    }
 }
 
 /*!
- * @brief Function gets random integer from min - max range (inclusive).
+ * @brief Function gets timestamp (in nanoseconds) from monotonic clock. It is never 0, so 0 can be used to mark that
+ * thread is not in queue or library.
  *
- * @param min Minimum number that can be generated.
- * @param max Maximum number that can be generated.
- * @return Random integer
+ * @return Timestamp in nanoseconds
  */
-int get_random(int min, int max) {
-    int range = max - min + 1;
-    return (rand() % range) + min;
+int64_t get_timestamp() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * NANOSECONDS_IN_SECOND + now.tv_nsec;
 }
 
 /*!
- * @brief Signal handler changes signal_flag to 0.
+ * @brief Function sleeps for given time or until signal_flag is reset - whichever comes first. It waits on
+ * shutdown_cond with monotonic clock deadline, so stopping threads does not have to wait for whole reading or writing
+ * time.
+ *
+ * @param nanoseconds Time to sleep in nanoseconds
  */
-void signal_handler() {
+void sleep_interruptible(int64_t nanoseconds) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += nanoseconds / NANOSECONDS_IN_SECOND;
+    deadline.tv_nsec += nanoseconds % NANOSECONDS_IN_SECOND;
+    if (deadline.tv_nsec >= NANOSECONDS_IN_SECOND) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= NANOSECONDS_IN_SECOND;
+    }
+    pthread_mutex_lock(&shutdown_mutex);
+    while (signal_flag) {
+        if (pthread_cond_timedwait(&shutdown_cond, &shutdown_mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shutdown_mutex);
+}
+
+/*!
+ * @brief Blocks main thread until SIGINT or SIGTERM is received (signals have to be blocked before). Thread does not
+ * use any CPU time while waiting. In debug mode function wakes up every second to print library state, if
+ * stats_interval is set - it wakes up every stats_interval seconds to print latency percentiles. If bench_duration is
+ * set, function returns after bench_duration seconds even if no signal was received.
+ */
+void wait_for_signal() {
+    sigset_t signal_set;
+    sigemptyset(&signal_set);
+    sigaddset(&signal_set, SIGINT);
+    sigaddset(&signal_set, SIGTERM);
+    if (is_debug_run || stats_interval || bench_duration) {
+        struct timespec timeout = {1, 0};
+        int seconds = 0;
+        while (sigtimedwait(&signal_set, NULL, &timeout) < 0) {
+            if (errno != EAGAIN) {
+                continue;
+            }
+            seconds++;
+            if (bench_duration && seconds >= bench_duration) {
+                break;
+            }
+            if (is_debug_run) {
+                print_debug();
+            }
+            if (stats_interval && seconds % stats_interval == 0) {
+                print_latency();
+            }
+        }
+    } else {
+        int signal_number;
+        sigwait(&signal_set, &signal_number);
+    }
+}
+
+/*!
+ * @brief Resets signal_flag and wakes up all threads waiting on conditional variables, so every thread finishes its
+ * loop in bounded time and can be joined. Mutexes of all libraries are locked (in order of libraries, nobody else
+ * holds two of them), because every thread waits with mutex of its own library. With other backends than
+ * RW_LOCK_NATIVE rw_lock of every library is shut down, so threads waiting for it give up (see rw_lock_shutdown).
+ */
+void stop_threads() {
+    int i;
+    for (i = 0;i < libraries_count;i++) {
+        adaptive_mutex_lock(&libraries[i].mutex);
+    }
+    pthread_mutex_lock(&shutdown_mutex);
     signal_flag = 0;
+    pthread_cond_broadcast(&shutdown_cond);
+    pthread_mutex_unlock(&shutdown_mutex);
+    for (i = 0;i < readers_count;i++) {
+        pthread_cond_broadcast(&readers_state[i].cond);
+    }
+    for (i = 0;i < writers_count;i++) {
+        pthread_cond_broadcast(&writers_state[i].cond);
+    }
+    for (i = libraries_count - 1;i >= 0;i--) {
+        adaptive_mutex_unlock(&libraries[i].mutex);
+    }
+    for (i = 0;i < libraries_count && lock_backend != RW_LOCK_NATIVE;i++) {
+        rw_lock_shutdown(&libraries[i].rw_lock);
+    }
 }
 
 /*!
  * @brief Arguments interpreter. Checks program arguments and sets global variables or exits program if arguments are
  * incorrect.
  * 1. Reads two first arguments - writers and readers count and sets it to global variables.
- * 2. (optional) Checks next arguments and enters debug mode or sets up times.
+ * 2. (optional) Checks next arguments (in any order) and enters debug mode, batch admission mode, sets up times (-t in
+ * seconds, -work in nanoseconds), latency statistics interval, benchmark duration and admissions limit, random numbers
+ * seed, distribution of times, lock backend, mutex mode, pin mode, task mode, trace file, number of libraries, Zipf
+ * exponent of choosing libraries or deadline of visits (in milliseconds). Debug, task, trace, seqlock and metrics
+ * modes work only with program's own scheme (RW_LOCK_NATIVE backend), deadline mode also with reader-writer library
+ * (RW_LOCK_FIFO and RW_LOCK_LIBRARIAN backends), trace mode, deadline mode and more than one library do not work in
+ * task mode.
  *
  * @param argc Arguments count
  * @param argv Array of arguments
@@ -592,81 +1877,256 @@ void args_interpreter(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
+    seed = (uint64_t) time(NULL);
     writers_count = atoi(argv[1]);
     readers_count = atoi(argv[2]);
 
-    if (argc > 3 ) {
-        if (strcmp(argv[3], "-t") == 0) {
-            if (argc < 8) {
+    for (int i = 3;i < argc;i++) {
+        if (strcmp(argv[i], "-t") == 0 || strcmp(argv[i], "-work") == 0) {
+            if (argc < i + 5) {
                 printf(ERROR_ARGUMENTS_MESSAGE);
                 exit(EXIT_FAILURE);
             } else {
-                int temp;
-                min_reading_time = atoi(argv[4]);
-                max_reading_time = atoi(argv[5]);
-                if (min_reading_time > max_reading_time) {
-                    temp = min_reading_time;
-                    min_reading_time = max_reading_time;
-                    max_reading_time = temp;
-                }
-                min_writing_time = atoi(argv[6]);
-                max_writing_time = atoi(argv[7]);
-                if (min_writing_time > max_writing_time) {
-                    temp = min_writing_time;
-                    min_writing_time = max_writing_time;
-                    max_writing_time = temp;
-                }
+                int64_t unit = strcmp(argv[i], "-t") == 0 ? NANOSECONDS_IN_SECOND : 1;
+                read_time_range(&argv[i + 1], unit, &min_reading_time, &max_reading_time);
+                read_time_range(&argv[i + 3], unit, &min_writing_time, &max_writing_time);
+                i += 4;
             }
-        } else if (strcmp(argv[3], "-debug") == 0) {
+        } else if (strcmp(argv[i], "-debug") == 0) {
             is_debug_run = 1;
+        } else if (strcmp(argv[i], "-batch") == 0) {
+            is_batch_admission = 1;
+        } else if (strcmp(argv[i], "-mutex") == 0) {
+            if (argc < i + 2 || adaptive_mutex_mode(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            mutex_mode = adaptive_mutex_mode(argv[++i]);
+        } else if (strcmp(argv[i], "-pin") == 0) {
+            if (argc < i + 2 || topology_pin_mode(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            pin_mode = topology_pin_mode(argv[++i]);
+        } else if (strcmp(argv[i], "-trace") == 0) {
+            if (argc < i + 2) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            trace_path = argv[++i];
+            is_trace_run = 1;
+        } else if (strcmp(argv[i], "-libraries") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            libraries_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-zipf") == 0) {
+            if (argc < i + 2 || atof(argv[i + 1]) <= 0.0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            zipf_exponent = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-tasks") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            task_workers = atoi(argv[++i]);
+            if (!task_workers) {
+                task_workers = task_pool_default_workers();
+            }
+            is_task_run = 1;
+        } else if (strcmp(argv[i], "-bench") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            bench_duration = atoi(argv[++i]);
+            is_bench_run = 1;
+        } else if (strcmp(argv[i], "-ops") == 0) {
+            if (argc < i + 2 || atoll(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            ops_limit = atoll(argv[++i]);
+            is_bench_run = 1;
+        } else if (strcmp(argv[i], "-seed") == 0) {
+            if (argc < i + 2) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-dist") == 0) {
+            if (argc < i + 2 || rng_distribution(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            time_distribution = rng_distribution(argv[++i]);
+        } else if (strcmp(argv[i], "-backend") == 0) {
+            if (argc < i + 2 || rw_lock_backend(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            lock_backend = rw_lock_backend(argv[++i]);
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            if (argc < i + 2 || atoi(argv[i + 1]) <= 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            stats_interval = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-deadline") == 0) {
+            if (argc < i + 2 || atoll(argv[i + 1]) < 0) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            deadline_time = atoll(argv[++i]) * NANOSECONDS_IN_MILLISECOND;
+            is_deadline_run = 1;
+        } else if (strcmp(argv[i], "-seqlock") == 0) {
+            is_seqlock_run = 1;
+        } else if (strcmp(argv[i], "-metrics") == 0) {
+            if (argc < i + 2) {
+                printf(ERROR_ARGUMENTS_MESSAGE);
+                exit(EXIT_FAILURE);
+            }
+            metrics_target = argv[++i];
+            is_metrics_run = 1;
         } else {
             printf(ERROR_ARGUMENTS_MESSAGE);
             exit(EXIT_FAILURE);
         }
     }
-
-    if (argc == 9) {
-        if (strcmp(argv[8], "-debug") == 0) {
-            is_debug_run = 1;
-        } else {
-            printf(ERROR_ARGUMENTS_MESSAGE);
+    if (((is_debug_run || is_task_run || is_trace_run || is_seqlock_run || is_metrics_run) &&
+         lock_backend != RW_LOCK_NATIVE) ||
+        (is_deadline_run && lock_backend != RW_LOCK_NATIVE && lock_backend != RW_LOCK_FIFO &&
+         lock_backend != RW_LOCK_LIBRARIAN) ||
+        ((is_trace_run || is_deadline_run || is_seqlock_run || libraries_count > 1) && is_task_run)) {
+        printf(ERROR_ARGUMENTS_MESSAGE);
+        exit(EXIT_FAILURE);
+    }
+    is_status_logged = !is_debug_run && !is_bench_run && lock_backend == RW_LOCK_NATIVE && libraries_count == 1;
+    is_queued_on_arrival = is_trace_run || is_deadline_run || libraries_count > 1;
+    if (is_trace_run) {
+        int error_line = trace_load(&trace, trace_path, readers_count, writers_count);
+        if (error_line) {
+            printf(error_line < 0 ? "Can not read trace file %s\n" : "Wrong record in trace file %s at line %i\n",
+                   trace_path, error_line);
             exit(EXIT_FAILURE);
         }
     }
+}
 
-    if (argc > 9) {
-        printf(ERROR_ARGUMENTS_MESSAGE);
-        exit(EXIT_FAILURE);
+/*!
+ * @brief Function reads range of times from two following arguments. If minimum is greater than maximum, they are
+ * swapped.
+ *
+ * @param arguments Two arguments - minimum and maximum time
+ * @param unit Number of nanoseconds in time unit used in arguments
+ * @param min Minimum time (in nanoseconds) to set
+ * @param max Maximum time (in nanoseconds) to set
+ */
+void read_time_range(char **arguments, int64_t unit, int64_t *min, int64_t *max) {
+    *min = atoll(arguments[0]) * unit;
+    *max = atoll(arguments[1]) * unit;
+    if (*min > *max) {
+        int64_t temp = *min;
+        *min = *max;
+        *max = temp;
     }
 }
 
 /*!
- * @brief Allocates memory for global variables.
+ * @brief Allocates memory for global variables. Arrays of per-thread states and histograms are allocated with
+ * topology_alloc, so on machine with more than one NUMA node every thread's state is in memory of its node.
  */
 void variables_initializer() {
-    srand(time(NULL));
-    readers_conds = malloc(readers_count * sizeof(pthread_cond_t));
-    writers_conds = malloc(writers_count * sizeof(pthread_cond_t));
-    queue = malloc((writers_count + readers_count) * (2 * sizeof(int) + sizeof(time_t)));
-    in_library = malloc((writers_count + readers_count) * (2 * sizeof(int) + sizeof(time_t)));
-    pthread_mutex_init(&mutex, NULL);
+    topology_init();
+    readers_state = topology_alloc(readers_count, sizeof(struct thread_state));
+    writers_state = topology_alloc(writers_count, sizeof(struct thread_state));
+    readers_latency = topology_alloc(readers_count, sizeof(struct latency_histograms));
+    writers_latency = topology_alloc(writers_count, sizeof(struct latency_histograms));
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    int i;
+    for (i = 0;i < readers_count;i++) {
+        pthread_cond_init(&readers_state[i].cond, &cond_attr);
+        readers_state[i].granted = 0;
+        histogram_init(&readers_latency[i].queue_wait);
+        histogram_init(&readers_latency[i].in_library);
+    }
+    for (i = 0;i < writers_count;i++) {
+        pthread_cond_init(&writers_state[i].cond, &cond_attr);
+        writers_state[i].granted = 0;
+        histogram_init(&writers_latency[i].queue_wait);
+        histogram_init(&writers_latency[i].in_library);
+    }
+    pthread_condattr_destroy(&cond_attr);
+    queue_capacity = (writers_count + readers_count) * (is_deadline_run ? 2 : 1);
+    libraries = aligned_alloc(CACHE_LINE_SIZE, libraries_count * sizeof(struct library));
+    for (i = 0;i < libraries_count;i++) {
+        struct library *library = &libraries[i];
+        adaptive_mutex_init(&library->mutex, mutex_mode);
+        library->queue = malloc(queue_capacity * sizeof(struct presence));
+        library->queue_head = 0;
+        library->queue_size = 0;
+        library->in_library = malloc(queue_capacity * sizeof(struct presence));
+        library->readers_queue_count = 0;
+        library->writers_queue_count = 0;
+        library->readers_in_library_count = 0;
+        library->writers_in_library_count = 0;
+        atomic_init(&library->admissions_count, 0);
+        library->phase_kind = NO_KIND;
+        seqlock_init(&library->seqlock);
+    }
+    if (zipf_exponent > 0.0 && libraries_count > 1) {
+        libraries_weights = malloc(libraries_count * sizeof(double));
+        rng_zipf_weights(libraries_weights, libraries_count, zipf_exponent);
+    }
+    pthread_mutex_init(&shutdown_mutex, NULL);
+    pthread_condattr_t shutdown_cond_attr;
+    pthread_condattr_init(&shutdown_cond_attr);
+    pthread_condattr_setclock(&shutdown_cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&shutdown_cond, &shutdown_cond_attr);
+    pthread_condattr_destroy(&shutdown_cond_attr);
 }
 
 /*!
  * @brief Frees memory allocated for global variables.
  */
 void cleaner() {
-    pthread_mutex_destroy(&mutex);
     int i;
+    for (i = 0;i < libraries_count;i++) {
+        if (lock_backend != RW_LOCK_NATIVE) {
+            rw_lock_destroy(&libraries[i].rw_lock);
+        }
+        adaptive_mutex_destroy(&libraries[i].mutex);
+        free(libraries[i].in_library);
+        free(libraries[i].queue);
+    }
+    free(libraries);
+    free(libraries_weights);
+    pthread_mutex_destroy(&shutdown_mutex);
+    pthread_cond_destroy(&shutdown_cond);
     for (i = 0;i < writers_count;i++) {
-        pthread_cond_destroy(&writers_conds[i]);
+        pthread_cond_destroy(&writers_state[i].cond);
     }
     for (i = 0;i < readers_count;i++) {
-        pthread_cond_destroy(&readers_conds[i]);
+        pthread_cond_destroy(&readers_state[i].cond);
+    }
+    free(writers_state);
+    free(readers_state);
+    free(readers_latency);
+    free(writers_latency);
+    if (is_task_run) {
+        task_pool_destroy();
+        free(readers_tasks);
+        free(writers_tasks);
+    }
+    if (is_trace_run) {
+        trace_destroy(&trace);
     }
-    free(in_library);
-    free(queue);
-    free(writers_conds);
+    topology_destroy();
 }
 
 #pragma clang diagnostic pop
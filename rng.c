@@ -0,0 +1,221 @@
+/*!
+ * @file
+ * Readers and Writers - random numbers
+ *
+ * Implementation of xoshiro256** generator seeded with splitmix64. Integer ranges are drawn with Lemire's
+ * multiply-and-reject method, so they have no modulo bias. Exponential and Pareto times are drawn by inverting their
+ * distribution functions truncated to min - max range, so every draw takes constant time.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include <string.h>
+#include <math.h>
+
+#include "rng.h"
+
+/*!
+ * @brief Function gets next value of splitmix64 generator (used only to expand seed to xoshiro256** state).
+ *
+ * @param state splitmix64 state
+ * @return Next value
+ */
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t value = (*state += 0x9e3779b97f4a7c15ULL);
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+/*!
+ * @brief Function rotates bits of value left.
+ *
+ * @param value Value
+ * @param bits Number of bits (1 - 63)
+ * @return Rotated value
+ */
+static uint64_t rotate_left(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+/*!
+ * @brief Seeds generator. Generators seeded with the same seed and different streams draw different sequences.
+ *
+ * @param rng Generator
+ * @param seed Common seed (from command line or clock)
+ * @param stream Stream number (different for every thread)
+ */
+void rng_seed(struct rng *rng, uint64_t seed, uint64_t stream) {
+    uint64_t state = seed ^ splitmix64(&stream);
+    for (int i = 0;i < 4;i++) {
+        rng->state[i] = splitmix64(&state);
+    }
+}
+
+/*!
+ * @brief Function gets next 64 random bits.
+ *
+ * @param rng Generator
+ * @return Random value
+ */
+uint64_t rng_next(struct rng *rng) {
+    uint64_t *s = rng->state;
+    uint64_t result = rotate_left(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotate_left(s[3], 45);
+    return result;
+}
+
+/*!
+ * @brief Function gets random integer from 0 - range - 1 range without modulo bias (Lemire's method - one
+ * multiplication, division only when draw may have to be rejected).
+ *
+ * @param rng Generator
+ * @param range Number of possible values (greater than 0)
+ * @return Random integer
+ */
+uint64_t rng_below(struct rng *rng, uint64_t range) {
+    __uint128_t product = (__uint128_t) rng_next(rng) * range;
+    uint64_t low = (uint64_t) product;
+    if (low < range) {
+        uint64_t threshold = -range % range;
+        while (low < threshold) {
+            product = (__uint128_t) rng_next(rng) * range;
+            low = (uint64_t) product;
+        }
+    }
+    return (uint64_t) (product >> 64);
+}
+
+/*!
+ * @brief Function gets random integer from min - max range (inclusive).
+ *
+ * @param rng Generator
+ * @param min Minimum number that can be generated.
+ * @param max Maximum number that can be generated.
+ * @return Random integer
+ */
+int64_t rng_range(struct rng *rng, int64_t min, int64_t max) {
+    if (max <= min) {
+        return min;
+    }
+    return min + (int64_t) rng_below(rng, (uint64_t) (max - min) + 1);
+}
+
+/*!
+ * @brief Function gets random number from [0, 1) range (53 random bits).
+ *
+ * @param rng Generator
+ * @return Random number
+ */
+double rng_double(struct rng *rng) {
+    return (double) (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+/*!
+ * @brief Function gets random time from min - max range drawn from given distribution:
+ * - RNG_UNIFORM - every value is equally probable,
+ * - RNG_EXPONENTIAL - min plus exponential value with mean equal half of range (before truncation to max),
+ * - RNG_PARETO - Pareto value with scale min (at least 1) and shape RNG_PARETO_SHAPE - most times are short, but some
+ * are close to max.
+ *
+ * @param rng Generator
+ * @param distribution Distribution (RNG_UNIFORM / RNG_EXPONENTIAL / RNG_PARETO)
+ * @param min Minimum time
+ * @param max Maximum time
+ * @return Random time
+ */
+int64_t rng_time(struct rng *rng, int distribution, int64_t min, int64_t max) {
+    if (max <= min) {
+        return min;
+    }
+    double value;
+    switch (distribution) {
+        case RNG_EXPONENTIAL: {
+            double width = (double) (max - min);
+            double mean = width / 2.0;
+            value = min - mean * log(1.0 - rng_double(rng) * (1.0 - exp(-width / mean)));
+            break;
+        }
+        case RNG_PARETO: {
+            double scale = min > 0 ? (double) min : 1.0;
+            double tail = pow(scale / (double) max, RNG_PARETO_SHAPE);
+            value = scale / pow(1.0 - rng_double(rng) * (1.0 - tail), 1.0 / RNG_PARETO_SHAPE);
+            break;
+        }
+        default:
+            return rng_range(rng, min, max);
+    }
+    if (value > (double) max) {
+        return max;
+    }
+    return value < (double) min ? min : (int64_t) value;
+}
+
+/*!
+ * @brief Function fills cumulative weights of Zipf distribution over count values - value i has weight
+ * 1 / (i + 1) ^ exponent, so value 0 is the most probable one (exponent 0 gives uniform distribution). Weights are
+ * normalised - the last one is 1.
+ *
+ * @param weights Array of count cumulative weights to fill
+ * @param count Number of values
+ * @param exponent Exponent of distribution (0 or greater)
+ */
+void rng_zipf_weights(double *weights, int count, double exponent) {
+    double sum = 0.0;
+    int i;
+    for (i = 0;i < count;i++) {
+        sum += 1.0 / pow(i + 1, exponent);
+        weights[i] = sum;
+    }
+    for (i = 0;i < count;i++) {
+        weights[i] /= sum;
+    }
+    weights[count - 1] = 1.0;
+}
+
+/*!
+ * @brief Function gets random value from 0 - count - 1 range drawn with given cumulative weights (see
+ * rng_zipf_weights). The value is found by binary search, so it takes O(log count) time.
+ *
+ * @param rng Generator
+ * @param weights Array of count cumulative weights (the last one is 1)
+ * @param count Number of values
+ * @return Random value
+ */
+int rng_pick(struct rng *rng, const double *weights, int count) {
+    double draw = rng_double(rng);
+    int first = 0;
+    int last = count - 1;
+    while (first < last) {
+        int middle = (first + last) / 2;
+        if (draw < weights[middle]) {
+            last = middle;
+        } else {
+            first = middle + 1;
+        }
+    }
+    return first;
+}
+
+/*!
+ * @brief Function gets distribution by its name.
+ *
+ * @param name Distribution name (uniform / exp / pareto)
+ * @return Distribution (RNG_UNIFORM / RNG_EXPONENTIAL / RNG_PARETO) or -1 if name is unknown
+ */
+int rng_distribution(const char *name) {
+    if (strcmp(name, "uniform") == 0) {
+        return RNG_UNIFORM;
+    } else if (strcmp(name, "exp") == 0) {
+        return RNG_EXPONENTIAL;
+    } else if (strcmp(name, "pareto") == 0) {
+        return RNG_PARETO;
+    }
+    return -1;
+}
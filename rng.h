@@ -0,0 +1,54 @@
+/*!
+ * @file
+ * Readers and Writers - random numbers
+ *
+ * Fast pseudo-random number generator (xoshiro256**) with state owned by calling thread - there is no hidden lock like
+ * in rand(), so threads drawing reading or writing times do not serialize on it. Every thread seeds its own state from
+ * common seed and its own stream number, so runs with the same seed draw the same times in every thread.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*!
+ * @brief Uniform distribution of times.
+ */
+#define RNG_UNIFORM 0
+/*!
+ * @brief Exponential distribution of times (truncated to min - max range).
+ */
+#define RNG_EXPONENTIAL 1
+/*!
+ * @brief Pareto distribution of times (truncated to min - max range).
+ */
+#define RNG_PARETO 2
+/*!
+ * @brief Shape of Pareto distribution (1.16 gives 80-20 rule).
+ */
+#define RNG_PARETO_SHAPE 1.16
+
+/*!
+ * @brief State of generator. It has to be used by one thread only.
+ */
+struct rng {
+/*!
+ * @brief xoshiro256** state (never all zeros)
+ */
+    uint64_t state[4];
+};
+
+void rng_seed(struct rng *rng, uint64_t seed, uint64_t stream);
+uint64_t rng_next(struct rng *rng);
+uint64_t rng_below(struct rng *rng, uint64_t range);
+int64_t rng_range(struct rng *rng, int64_t min, int64_t max);
+double rng_double(struct rng *rng);
+int64_t rng_time(struct rng *rng, int distribution, int64_t min, int64_t max);
+void rng_zipf_weights(double *weights, int count, double exponent);
+int rng_pick(struct rng *rng, const double *weights, int count);
+int rng_distribution(const char *name);
+
+#endif
@@ -0,0 +1,587 @@
+/*!
+ * @file
+ * Readers and Writers - reader-writer library
+ *
+ * Implementation of reader-writer library. Waiting threads are nodes of doubly linked queue kept on stacks of theirs
+ * threads - every node has its own conditional variable (so admitted thread is woken up alone) and thread that gives
+ * up unlinks its node without searching the queue. In RW_LIBRARY_LIBRARIAN policy only writers wait in queue (it is
+ * ordered by arrival, so writer that waits the longest is always first) and readers wait on one conditional variable
+ * till writer phase ends. Conditional variables measure time with CLOCK_MONOTONIC.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "rw_library.h"
+
+/*!
+ * @brief Kind of waiting reader.
+ */
+#define WAITER_READER 0
+/*!
+ * @brief Kind of waiting writer.
+ */
+#define WAITER_WRITER 1
+
+/*!
+ * @brief Thread waiting in queue of library.
+ */
+struct waiter {
+/*!
+ * @brief conditional variable signalled when thread is let in
+ */
+    pthread_cond_t cond;
+/*!
+ * @brief kind of thread (WAITER_READER / WAITER_WRITER)
+ */
+    int kind;
+/*!
+ * @brief flag set when thread is let in (it is already counted in library)
+ */
+    int granted;
+/*!
+ * @brief previous thread in queue, NULL for first one
+ */
+    struct waiter *previous;
+/*!
+ * @brief next thread in queue, NULL for last one
+ */
+    struct waiter *next;
+};
+
+/*!
+ * @brief Library.
+ */
+struct rw_library {
+/*!
+ * @brief policy (RW_LIBRARY_FIFO / RW_LIBRARY_LIBRARIAN)
+ */
+    int policy;
+/*!
+ * @brief length of read window in nanoseconds (RW_LIBRARY_LIBRARIAN)
+ */
+    int64_t read_window;
+/*!
+ * @brief mutex of library state
+ */
+    pthread_mutex_t mutex;
+/*!
+ * @brief attributes of conditional variables (CLOCK_MONOTONIC)
+ */
+    pthread_condattr_t cond_attr;
+/*!
+ * @brief first thread in queue
+ */
+    struct waiter *queue_head;
+/*!
+ * @brief last thread in queue
+ */
+    struct waiter *queue_tail;
+/*!
+ * @brief number of readers in library
+ */
+    int readers_in_library_count;
+/*!
+ * @brief number of writers in library (0 or 1)
+ */
+    int writers_in_library_count;
+/*!
+ * @brief flag set by librarian when read window ends - readers are not let in (RW_LIBRARY_LIBRARIAN)
+ */
+    int writer_notification;
+/*!
+ * @brief number of readers waiting on readers_cond (RW_LIBRARY_LIBRARIAN)
+ */
+    int waiting_readers_count;
+/*!
+ * @brief conditional variable readers wait on till writer phase ends (RW_LIBRARY_LIBRARIAN)
+ */
+    pthread_cond_t readers_cond;
+/*!
+ * @brief conditional variable librarian waits on (RW_LIBRARY_LIBRARIAN)
+ */
+    pthread_cond_t librarian_cond;
+/*!
+ * @brief librarian thread (RW_LIBRARY_LIBRARIAN)
+ */
+    pthread_t librarian;
+/*!
+ * @brief flag set by rw_library_destroy to stop librarian
+ */
+    int is_stopped;
+/*!
+ * @brief flag set by rw_library_shutdown - nobody is let in any more and waiting threads give up
+ */
+    int is_shut_down;
+/*!
+ * @brief number of threads let in to library (WAITER_READER / WAITER_WRITER position)
+ */
+    long long admitted_count[2];
+/*!
+ * @brief number of threads that gave up entering library - try variant could not enter at once or deadline of timed
+ * variant passed (WAITER_READER / WAITER_WRITER position)
+ */
+    long long gave_up_count[2];
+};
+
+/*!
+ * @brief Function puts thread at last position of queue.
+ *
+ * @param library Library
+ * @param waiter Waiting thread
+ */
+static void enqueue(struct rw_library *library, struct waiter *waiter) {
+    waiter->previous = library->queue_tail;
+    waiter->next = NULL;
+    if (library->queue_tail) {
+        library->queue_tail->next = waiter;
+    } else {
+        library->queue_head = waiter;
+    }
+    library->queue_tail = waiter;
+}
+
+/*!
+ * @brief Function takes thread off from queue (from any position).
+ *
+ * @param library Library
+ * @param waiter Waiting thread
+ */
+static void unlink_waiter(struct rw_library *library, struct waiter *waiter) {
+    if (waiter->previous) {
+        waiter->previous->next = waiter->next;
+    } else {
+        library->queue_head = waiter->next;
+    }
+    if (waiter->next) {
+        waiter->next->previous = waiter->previous;
+    } else {
+        library->queue_tail = waiter->previous;
+    }
+}
+
+/*!
+ * @brief Function takes thread off from queue, puts it to library, sets its granted flag and wakes it up.
+ *
+ * @param library Library
+ * @param waiter Waiting thread
+ */
+static void grant(struct rw_library *library, struct waiter *waiter) {
+    unlink_waiter(library, waiter);
+    if (waiter->kind == WAITER_READER) {
+        library->readers_in_library_count++;
+    } else {
+        library->writers_in_library_count++;
+    }
+    waiter->granted = 1;
+    pthread_cond_signal(&waiter->cond);
+}
+
+/*!
+ * @brief RW_LIBRARY_FIFO policy: function lets in threads from first position of queue - readers while there is no
+ * writer in library, writer if library is empty.
+ *
+ * @param library Library
+ */
+static void admit(struct rw_library *library) {
+    while (library->queue_head && !library->writers_in_library_count && !library->is_shut_down) {
+        struct waiter *waiter = library->queue_head;
+        if (waiter->kind == WAITER_WRITER && library->readers_in_library_count) {
+            return;
+        }
+        grant(library, waiter);
+    }
+}
+
+/*!
+ * @brief Function counts result of entering library - admission or giving up (EBUSY / ETIMEDOUT). Threads cancelled by
+ * rw_library_shutdown are not counted. Mutex of library has to be locked.
+ *
+ * @param library Library
+ * @param kind Kind of thread (WAITER_READER / WAITER_WRITER)
+ * @param result Result of entering (0 / EBUSY / ETIMEDOUT / ECANCELED)
+ */
+static void count_result(struct rw_library *library, int kind, int result) {
+    if (!result) {
+        library->admitted_count[kind]++;
+    } else if (result != ECANCELED) {
+        library->gave_up_count[kind]++;
+    }
+}
+
+/*!
+ * @brief Function computes absolute CLOCK_MONOTONIC time that is given number of nanoseconds from now.
+ *
+ * @param time Time to set
+ * @param nanoseconds Nanoseconds from now
+ */
+static void monotonic_after(struct timespec *time, int64_t nanoseconds) {
+    clock_gettime(CLOCK_MONOTONIC, time);
+    int64_t sum = time->tv_nsec + nanoseconds;
+    time->tv_sec += sum / 1000000000;
+    time->tv_nsec = sum % 1000000000;
+}
+
+/*!
+ * @brief Function puts thread to queue and waits (with mutex locked) till it is let in, till deadline passes or till
+ * library is shut down - then thread is taken off from queue (if it was first in RW_LIBRARY_FIFO queue, threads after
+ * it may be let in).
+ *
+ * @param library Library
+ * @param kind Kind of thread (WAITER_READER / WAITER_WRITER)
+ * @param deadline Absolute CLOCK_MONOTONIC deadline, NULL to wait without limit
+ * @return 0 if thread was let in, ETIMEDOUT if deadline passed, ECANCELED if library was shut down
+ */
+static int wait_in_queue(struct rw_library *library, int kind, const struct timespec *deadline) {
+    struct waiter waiter;
+    pthread_cond_init(&waiter.cond, &library->cond_attr);
+    waiter.kind = kind;
+    waiter.granted = 0;
+    int was_empty = !library->queue_head;
+    enqueue(library, &waiter);
+    if (library->policy == RW_LIBRARY_LIBRARIAN && was_empty) {
+        pthread_cond_signal(&library->librarian_cond);
+    }
+    int result = 0;
+    while (!waiter.granted && !result) {
+        if (library->is_shut_down) {
+            result = ECANCELED;
+        } else if (!deadline) {
+            pthread_cond_wait(&waiter.cond, &library->mutex);
+        } else if (pthread_cond_timedwait(&waiter.cond, &library->mutex, deadline) == ETIMEDOUT && !waiter.granted) {
+            result = ETIMEDOUT;
+        }
+    }
+    if (result) {
+        int was_first = library->queue_head == &waiter;
+        unlink_waiter(library, &waiter);
+        if (library->policy == RW_LIBRARY_FIFO && was_first) {
+            admit(library);
+        }
+    }
+    pthread_cond_destroy(&waiter.cond);
+    return result;
+}
+
+/*!
+ * @brief Librarian thread of RW_LIBRARY_LIBRARIAN policy. It works until library is destroyed. When a writer gets to
+ * queue, librarian lets readers in for read window, then sets writer_notification, waits till library is empty and
+ * lets in first writer from queue (if it has not given up - then writer phase ends at once). Writer phase ends when
+ * writer leaves (rw_library_writer_exit resets writer_notification and wakes up all waiting readers). After
+ * rw_library_shutdown librarian does not let anybody in - it only waits till library is destroyed.
+ *
+ * @param arg Library
+ * @return NULL
+ */
+static void* librarian(void *arg) {
+    struct rw_library *library = arg;
+    pthread_mutex_lock(&library->mutex);
+    while (!library->is_stopped) {
+        if (!library->queue_head || library->is_shut_down) {
+            pthread_cond_wait(&library->librarian_cond, &library->mutex);
+            continue;
+        }
+        struct timespec window_end;
+        monotonic_after(&window_end, library->read_window);
+        while (!library->is_stopped &&
+               pthread_cond_timedwait(&library->librarian_cond, &library->mutex, &window_end) != ETIMEDOUT) {
+            continue;
+        }
+        library->writer_notification = 1;
+        while (!library->is_stopped && (library->readers_in_library_count || library->writers_in_library_count)) {
+            pthread_cond_wait(&library->librarian_cond, &library->mutex);
+        }
+        if (!library->is_stopped && !library->is_shut_down && library->queue_head) {
+            grant(library, library->queue_head);
+            while (!library->is_stopped && library->writers_in_library_count) {
+                pthread_cond_wait(&library->librarian_cond, &library->mutex);
+            }
+        } else {
+            library->writer_notification = 0;
+            if (library->waiting_readers_count) {
+                pthread_cond_broadcast(&library->readers_cond);
+            }
+        }
+    }
+    pthread_mutex_unlock(&library->mutex);
+    return NULL;
+}
+
+/*!
+ * @brief Creates library.
+ *
+ * @param policy Policy (RW_LIBRARY_FIFO / RW_LIBRARY_LIBRARIAN)
+ * @param read_window Length of read window in nanoseconds (used by RW_LIBRARY_LIBRARIAN only)
+ * @return Library (it has to be destroyed with rw_library_destroy) or NULL if it can not be created
+ */
+struct rw_library* rw_library_init(int policy, int64_t read_window) {
+    struct rw_library *library = malloc(sizeof(struct rw_library));
+    if (!library) {
+        return NULL;
+    }
+    memset(library, 0, sizeof(struct rw_library));
+    library->policy = policy;
+    library->read_window = read_window;
+    pthread_mutex_init(&library->mutex, NULL);
+    pthread_condattr_init(&library->cond_attr);
+    pthread_condattr_setclock(&library->cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&library->readers_cond, &library->cond_attr);
+    pthread_cond_init(&library->librarian_cond, &library->cond_attr);
+    if (policy == RW_LIBRARY_LIBRARIAN && pthread_create(&library->librarian, NULL, librarian, library)) {
+        pthread_cond_destroy(&library->librarian_cond);
+        pthread_cond_destroy(&library->readers_cond);
+        pthread_condattr_destroy(&library->cond_attr);
+        pthread_mutex_destroy(&library->mutex);
+        free(library);
+        return NULL;
+    }
+    return library;
+}
+
+/*!
+ * @brief Destroys library - stops its librarian and frees memory. Library has to be empty and nobody can wait in its
+ * queue.
+ *
+ * @param library Library
+ */
+void rw_library_destroy(struct rw_library *library) {
+    if (library->policy == RW_LIBRARY_LIBRARIAN) {
+        pthread_mutex_lock(&library->mutex);
+        library->is_stopped = 1;
+        pthread_cond_signal(&library->librarian_cond);
+        pthread_mutex_unlock(&library->mutex);
+        pthread_join(library->librarian, NULL);
+    }
+    pthread_cond_destroy(&library->librarian_cond);
+    pthread_cond_destroy(&library->readers_cond);
+    pthread_condattr_destroy(&library->cond_attr);
+    pthread_mutex_destroy(&library->mutex);
+    free(library);
+}
+
+/*!
+ * @brief Function shuts library down: nobody is let in any more and every thread waiting to enter (and every thread
+ * that tries to enter later) gives up with ECANCELED, so threads using library can finish in bounded time. Threads
+ * that are already in library leave it as usual. Library still has to be destroyed with rw_library_destroy.
+ *
+ * @param library Library
+ */
+void rw_library_shutdown(struct rw_library *library) {
+    pthread_mutex_lock(&library->mutex);
+    library->is_shut_down = 1;
+    for (struct waiter *waiter = library->queue_head;waiter;waiter = waiter->next) {
+        pthread_cond_signal(&waiter->cond);
+    }
+    pthread_cond_broadcast(&library->readers_cond);
+    pthread_cond_signal(&library->librarian_cond);
+    pthread_mutex_unlock(&library->mutex);
+}
+
+/*!
+ * @brief Function lets reader in to library (RW_LIBRARY_FIFO - after every thread that waits in queue, when there is
+ * no writer in library, RW_LIBRARY_LIBRARIAN - when writer phase is over).
+ *
+ * @param library Library
+ * @param is_try 1 if reader does not wait
+ * @param deadline Absolute CLOCK_MONOTONIC deadline, NULL to wait without limit
+ * @return 0 if reader is in library, EBUSY if it would have to wait (is_try), ETIMEDOUT if deadline passed, ECANCELED
+ * if library is shut down
+ */
+static int reader_enter(struct rw_library *library, int is_try, const struct timespec *deadline) {
+    pthread_mutex_lock(&library->mutex);
+    int result = 0;
+    if (library->is_shut_down) {
+        result = ECANCELED;
+    } else if (library->policy == RW_LIBRARY_FIFO) {
+        if (!library->queue_head && !library->writers_in_library_count) {
+            library->readers_in_library_count++;
+        } else {
+            result = is_try ? EBUSY : wait_in_queue(library, WAITER_READER, deadline);
+        }
+    } else if (library->writer_notification || library->writers_in_library_count) {
+        if (is_try) {
+            result = EBUSY;
+        } else {
+            library->waiting_readers_count++;
+            while ((library->writer_notification || library->writers_in_library_count) && !result) {
+                if (library->is_shut_down) {
+                    result = ECANCELED;
+                } else if (!deadline) {
+                    pthread_cond_wait(&library->readers_cond, &library->mutex);
+                } else if (pthread_cond_timedwait(&library->readers_cond, &library->mutex, deadline) == ETIMEDOUT &&
+                           (library->writer_notification || library->writers_in_library_count)) {
+                    result = ETIMEDOUT;
+                }
+            }
+            library->waiting_readers_count--;
+            library->readers_in_library_count += !result;
+        }
+    } else {
+        library->readers_in_library_count++;
+    }
+    count_result(library, WAITER_READER, result);
+    pthread_mutex_unlock(&library->mutex);
+    return result;
+}
+
+/*!
+ * @brief Function lets writer in to library (RW_LIBRARY_FIFO - after every thread that waits in queue, when library is
+ * empty, RW_LIBRARY_LIBRARIAN - at once if library is empty and no writer waits, otherwise when librarian lets it in).
+ *
+ * @param library Library
+ * @param is_try 1 if writer does not wait
+ * @param deadline Absolute CLOCK_MONOTONIC deadline, NULL to wait without limit
+ * @return 0 if writer is in library, EBUSY if it would have to wait (is_try), ETIMEDOUT if deadline passed, ECANCELED
+ * if library is shut down
+ */
+static int writer_enter(struct rw_library *library, int is_try, const struct timespec *deadline) {
+    pthread_mutex_lock(&library->mutex);
+    int result = 0;
+    if (library->is_shut_down) {
+        result = ECANCELED;
+    } else if (!library->queue_head && !library->readers_in_library_count && !library->writers_in_library_count &&
+        !library->writer_notification) {
+        library->writers_in_library_count++;
+    } else {
+        result = is_try ? EBUSY : wait_in_queue(library, WAITER_WRITER, deadline);
+    }
+    count_result(library, WAITER_WRITER, result);
+    pthread_mutex_unlock(&library->mutex);
+    return result;
+}
+
+/*!
+ * @brief Function lets reader in to library. It waits as long as it is needed (or till library is shut down).
+ *
+ * @param library Library
+ * @return 0 if reader is in library, ECANCELED if library is shut down
+ */
+int rw_library_reader_enter(struct rw_library *library) {
+    return reader_enter(library, 0, NULL);
+}
+
+/*!
+ * @brief Function lets reader in to library only if it does not have to wait.
+ *
+ * @param library Library
+ * @return 0 if reader is in library, EBUSY if it would have to wait, ECANCELED if library is shut down
+ */
+int rw_library_reader_try_enter(struct rw_library *library) {
+    return reader_enter(library, 1, NULL);
+}
+
+/*!
+ * @brief Function lets reader in to library if it happens before deadline.
+ *
+ * @param library Library
+ * @param deadline Absolute CLOCK_MONOTONIC deadline
+ * @return 0 if reader is in library, ETIMEDOUT if deadline passed, ECANCELED if library is shut down
+ */
+int rw_library_reader_timed_enter(struct rw_library *library, const struct timespec *deadline) {
+    return reader_enter(library, 0, deadline);
+}
+
+/*!
+ * @brief Function takes reader out of library.
+ *
+ * @param library Library
+ */
+void rw_library_reader_exit(struct rw_library *library) {
+    pthread_mutex_lock(&library->mutex);
+    library->readers_in_library_count--;
+    if (library->policy == RW_LIBRARY_FIFO) {
+        admit(library);
+    } else if (!library->readers_in_library_count && library->writer_notification) {
+        pthread_cond_signal(&library->librarian_cond);
+    }
+    pthread_mutex_unlock(&library->mutex);
+}
+
+/*!
+ * @brief Function lets writer in to library. It waits as long as it is needed (or till library is shut down).
+ *
+ * @param library Library
+ * @return 0 if writer is in library, ECANCELED if library is shut down
+ */
+int rw_library_writer_enter(struct rw_library *library) {
+    return writer_enter(library, 0, NULL);
+}
+
+/*!
+ * @brief Function lets writer in to library only if it does not have to wait.
+ *
+ * @param library Library
+ * @return 0 if writer is in library, EBUSY if it would have to wait, ECANCELED if library is shut down
+ */
+int rw_library_writer_try_enter(struct rw_library *library) {
+    return writer_enter(library, 1, NULL);
+}
+
+/*!
+ * @brief Function lets writer in to library if it happens before deadline.
+ *
+ * @param library Library
+ * @param deadline Absolute CLOCK_MONOTONIC deadline
+ * @return 0 if writer is in library, ETIMEDOUT if deadline passed, ECANCELED if library is shut down
+ */
+int rw_library_writer_timed_enter(struct rw_library *library, const struct timespec *deadline) {
+    return writer_enter(library, 0, deadline);
+}
+
+/*!
+ * @brief Function takes writer out of library. RW_LIBRARY_LIBRARIAN policy: writer phase ends, so all waiting readers
+ * are woken up.
+ *
+ * @param library Library
+ */
+void rw_library_writer_exit(struct rw_library *library) {
+    pthread_mutex_lock(&library->mutex);
+    library->writers_in_library_count--;
+    if (library->policy == RW_LIBRARY_FIFO) {
+        admit(library);
+    } else {
+        library->writer_notification = 0;
+        if (library->waiting_readers_count) {
+            pthread_cond_broadcast(&library->readers_cond);
+        }
+        pthread_cond_signal(&library->librarian_cond);
+    }
+    pthread_mutex_unlock(&library->mutex);
+}
+
+/*!
+ * @brief Function copies numbers of readers and writers let in to library and of readers and writers that gave up
+ * (try variant could not enter at once or deadline of timed variant passed).
+ *
+ * @param library Library
+ * @param counts Counts to set
+ */
+void rw_library_get_counts(struct rw_library *library, struct rw_library_counts *counts) {
+    pthread_mutex_lock(&library->mutex);
+    counts->readers_admitted = library->admitted_count[WAITER_READER];
+    counts->readers_gave_up = library->gave_up_count[WAITER_READER];
+    counts->writers_admitted = library->admitted_count[WAITER_WRITER];
+    counts->writers_gave_up = library->gave_up_count[WAITER_WRITER];
+    pthread_mutex_unlock(&library->mutex);
+}
+
+/*!
+ * @brief Function gets policy by its name.
+ *
+ * @param name Policy name (fifo / librarian)
+ * @return Policy (RW_LIBRARY_FIFO / RW_LIBRARY_LIBRARIAN) or -1 if name is unknown
+ */
+int rw_library_policy(const char *name) {
+    if (strcmp(name, "fifo") == 0) {
+        return RW_LIBRARY_FIFO;
+    } else if (strcmp(name, "librarian") == 0) {
+        return RW_LIBRARY_LIBRARIAN;
+    }
+    return -1;
+}
@@ -0,0 +1,81 @@
+/*!
+ * @file
+ * Readers and Writers - reader-writer library
+ *
+ * Both admission policies of the program as a reusable reader-writer lock. Every library is a separate handle (all its
+ * state is kept in it, there are no globals), so a program can use as many libraries as it needs:
+ * - RW_LIBRARY_FIFO - policy of implementation 2: readers and writers wait in one FIFO queue, reader at first
+ * position is let in if there is no writer in library and writer at first position is let in if library is empty,
+ * - RW_LIBRARY_LIBRARIAN - policy of implementation 1: readers are let in until librarian thread of library (started
+ * by rw_library_init) ends read window, then librarian waits till library is empty and lets in the writer that waits
+ * the longest. Read window starts when a writer gets to queue.
+ *
+ * Every enter function has a try variant (it does not wait at all) and a timed variant (it waits till absolute
+ * deadline measured with CLOCK_MONOTONIC). Thread that gives up is taken off from queue in constant time.
+ *
+ * Library counts threads let in and threads that gave up (try and timed variants) per role, see
+ * rw_library_get_counts.
+ *
+ * rw_library_shutdown lets program stop threads that use library: every thread waiting to enter gives up with
+ * ECANCELED (and so does every later attempt to enter), while threads already in library leave it as usual.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef RW_LIBRARY_H
+#define RW_LIBRARY_H
+
+#include <stdint.h>
+#include <time.h>
+
+/*!
+ * @brief One FIFO queue of readers and writers (implementation 2).
+ */
+#define RW_LIBRARY_FIFO 0
+/*!
+ * @brief Read windows and writer phases of librarian thread (implementation 1).
+ */
+#define RW_LIBRARY_LIBRARIAN 1
+
+/*!
+ * @brief Library (its fields are private to rw_library.c).
+ */
+struct rw_library;
+
+/*!
+ * @brief Numbers of threads let in to library and threads that gave up entering it.
+ */
+struct rw_library_counts {
+/*!
+ * @brief number of readers let in
+ */
+    long long readers_admitted;
+/*!
+ * @brief number of readers that gave up (EBUSY / ETIMEDOUT)
+ */
+    long long readers_gave_up;
+/*!
+ * @brief number of writers let in
+ */
+    long long writers_admitted;
+/*!
+ * @brief number of writers that gave up (EBUSY / ETIMEDOUT)
+ */
+    long long writers_gave_up;
+};
+
+struct rw_library* rw_library_init(int policy, int64_t read_window);
+void rw_library_destroy(struct rw_library *library);
+void rw_library_shutdown(struct rw_library *library);
+int rw_library_reader_enter(struct rw_library *library);
+int rw_library_reader_try_enter(struct rw_library *library);
+int rw_library_reader_timed_enter(struct rw_library *library, const struct timespec *deadline);
+void rw_library_reader_exit(struct rw_library *library);
+int rw_library_writer_enter(struct rw_library *library);
+int rw_library_writer_try_enter(struct rw_library *library);
+int rw_library_writer_timed_enter(struct rw_library *library, const struct timespec *deadline);
+void rw_library_writer_exit(struct rw_library *library);
+void rw_library_get_counts(struct rw_library *library, struct rw_library_counts *counts);
+int rw_library_policy(const char *name);
+
+#endif
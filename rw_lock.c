@@ -0,0 +1,256 @@
+/*!
+ * @file
+ * Readers and Writers - reader-writer lock backends
+ *
+ * Implementation of reader-writer lock backends. Phase-fair lock waits by spinning on shared counters - after
+ * RW_LOCK_SPINS tries waiting thread yields processor, so lock does not stall when there are more threads than cores.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <sched.h>
+
+#include "rw_lock.h"
+
+/*!
+ * @brief Number of tries after which spinning thread starts to yield processor.
+ */
+#define RW_LOCK_SPINS 100
+
+/*!
+ * @brief Phase-fair lock: readers ticket increment (lower bits of readers_in are used by writer).
+ */
+#define PHASE_FAIR_READER 0x100u
+/*!
+ * @brief Phase-fair lock: both writer bits of readers_in.
+ */
+#define PHASE_FAIR_WRITER_BITS 0x3u
+/*!
+ * @brief Phase-fair lock: writer present bit of readers_in.
+ */
+#define PHASE_FAIR_WRITER_PRESENT 0x2u
+/*!
+ * @brief Phase-fair lock: writer phase bit of readers_in (changes with every writer, so reader can notice that writer
+ * phase ended even if next writer is already waiting).
+ */
+#define PHASE_FAIR_PHASE 0x1u
+
+/*!
+ * @brief Function is called in every iteration of spinning loop. It pauses processor and after RW_LOCK_SPINS
+ * iterations yields it to other threads.
+ *
+ * @param spins Number of iterations (increased by function)
+ */
+static void spin(unsigned int *spins) {
+    if (++*spins > RW_LOCK_SPINS) {
+        sched_yield();
+        return;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+/*!
+ * @brief Initialises lock.
+ *
+ * @param lock Lock
+ * @param backend Backend (RW_LOCK_PTHREAD / RW_LOCK_PHASE_FAIR / RW_LOCK_FIFO / RW_LOCK_LIBRARIAN)
+ * @param read_window Length of read window in nanoseconds (used by RW_LOCK_LIBRARIAN only)
+ */
+void rw_lock_init(struct rw_lock *lock, int backend, int64_t read_window) {
+    memset(lock, 0, sizeof(struct rw_lock));
+    lock->backend = backend;
+    if (backend == RW_LOCK_FIFO || backend == RW_LOCK_LIBRARIAN) {
+        lock->library = rw_library_init(backend == RW_LOCK_FIFO ? RW_LIBRARY_FIFO : RW_LIBRARY_LIBRARIAN,
+                                        read_window);
+    } else if (backend == RW_LOCK_PTHREAD) {
+        pthread_rwlockattr_t attr;
+        pthread_rwlockattr_init(&attr);
+        pthread_rwlockattr_setkind_np(&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+        pthread_rwlock_init(&lock->rwlock, &attr);
+        pthread_rwlockattr_destroy(&attr);
+    } else {
+        atomic_init(&lock->readers_in, 0);
+        atomic_init(&lock->readers_out, 0);
+        atomic_init(&lock->writers_in, 0);
+        atomic_init(&lock->writers_out, 0);
+    }
+}
+
+/*!
+ * @brief Destroys lock.
+ *
+ * @param lock Lock
+ */
+void rw_lock_destroy(struct rw_lock *lock) {
+    if (lock->backend == RW_LOCK_PTHREAD) {
+        pthread_rwlock_destroy(&lock->rwlock);
+    } else if (lock->library) {
+        rw_library_destroy(lock->library);
+    }
+}
+
+/*!
+ * @brief Locks lock for reading. Phase-fair lock: reader takes ticket and, if writer is present, waits till writer
+ * phase bits change (writer that was present leaves).
+ *
+ * @param lock Lock
+ * @return 0 if lock is locked, ECANCELED if lock is shut down (RW_LOCK_FIFO and RW_LOCK_LIBRARIAN only)
+ */
+int rw_lock_read_lock(struct rw_lock *lock) {
+    if (lock->backend == RW_LOCK_PTHREAD) {
+        pthread_rwlock_rdlock(&lock->rwlock);
+        return 0;
+    } else if (lock->library) {
+        return rw_library_reader_enter(lock->library);
+    }
+    unsigned int writer = atomic_fetch_add_explicit(&lock->readers_in, PHASE_FAIR_READER, memory_order_acquire) &
+                          PHASE_FAIR_WRITER_BITS;
+    unsigned int spins = 0;
+    while (writer &&
+           (atomic_load_explicit(&lock->readers_in, memory_order_acquire) & PHASE_FAIR_WRITER_BITS) == writer) {
+        spin(&spins);
+    }
+    return 0;
+}
+
+/*!
+ * @brief Unlocks lock locked for reading.
+ *
+ * @param lock Lock
+ */
+void rw_lock_read_unlock(struct rw_lock *lock) {
+    if (lock->backend == RW_LOCK_PTHREAD) {
+        pthread_rwlock_unlock(&lock->rwlock);
+        return;
+    }
+    if (lock->library) {
+        rw_library_reader_exit(lock->library);
+        return;
+    }
+    atomic_fetch_add_explicit(&lock->readers_out, PHASE_FAIR_READER, memory_order_release);
+}
+
+/*!
+ * @brief Locks lock for writing. Phase-fair lock: writer waits for its turn among writers (FIFO ticket), then it sets
+ * writer bits (blocking new readers) and waits till all readers that entered before leave.
+ *
+ * @param lock Lock
+ * @return 0 if lock is locked, ECANCELED if lock is shut down (RW_LOCK_FIFO and RW_LOCK_LIBRARIAN only)
+ */
+int rw_lock_write_lock(struct rw_lock *lock) {
+    if (lock->backend == RW_LOCK_PTHREAD) {
+        pthread_rwlock_wrlock(&lock->rwlock);
+        return 0;
+    } else if (lock->library) {
+        return rw_library_writer_enter(lock->library);
+    }
+    unsigned int ticket = atomic_fetch_add_explicit(&lock->writers_in, 1, memory_order_relaxed);
+    unsigned int spins = 0;
+    while (atomic_load_explicit(&lock->writers_out, memory_order_acquire) != ticket) {
+        spin(&spins);
+    }
+    unsigned int writer = PHASE_FAIR_WRITER_PRESENT | (ticket & PHASE_FAIR_PHASE);
+    unsigned int readers_ticket = atomic_fetch_add_explicit(&lock->readers_in, writer, memory_order_acquire);
+    spins = 0;
+    while (atomic_load_explicit(&lock->readers_out, memory_order_acquire) != readers_ticket) {
+        spin(&spins);
+    }
+    return 0;
+}
+
+/*!
+ * @brief Unlocks lock locked for writing. Phase-fair lock: writer clears writer bits (letting waiting readers in) and
+ * passes turn to next writer.
+ *
+ * @param lock Lock
+ */
+void rw_lock_write_unlock(struct rw_lock *lock) {
+    if (lock->backend == RW_LOCK_PTHREAD) {
+        pthread_rwlock_unlock(&lock->rwlock);
+        return;
+    }
+    if (lock->library) {
+        rw_library_writer_exit(lock->library);
+        return;
+    }
+    atomic_fetch_and_explicit(&lock->readers_in, ~PHASE_FAIR_WRITER_BITS, memory_order_release);
+    atomic_fetch_add_explicit(&lock->writers_out, 1, memory_order_release);
+}
+
+/*!
+ * @brief Locks lock for reading if it happens before deadline - RW_LOCK_FIFO and RW_LOCK_LIBRARIAN only (other
+ * backends lock without limit). Admissions and give-ups are counted by library (see rw_library_get_counts).
+ *
+ * @param lock Lock
+ * @param deadline Absolute CLOCK_MONOTONIC deadline, NULL to lock only if it does not have to wait
+ * @return 0 if lock is locked, EBUSY if it would have to wait, ETIMEDOUT if deadline passed, ECANCELED if lock is shut
+ * down
+ */
+int rw_lock_timed_read_lock(struct rw_lock *lock, const struct timespec *deadline) {
+    if (!lock->library) {
+        return rw_lock_read_lock(lock);
+    }
+    if (!deadline) {
+        return rw_library_reader_try_enter(lock->library);
+    }
+    return rw_library_reader_timed_enter(lock->library, deadline);
+}
+
+/*!
+ * @brief Locks lock for writing if it happens before deadline - RW_LOCK_FIFO and RW_LOCK_LIBRARIAN only (other
+ * backends lock without limit). Admissions and give-ups are counted by library (see rw_library_get_counts).
+ *
+ * @param lock Lock
+ * @param deadline Absolute CLOCK_MONOTONIC deadline, NULL to lock only if it does not have to wait
+ * @return 0 if lock is locked, EBUSY if it would have to wait, ETIMEDOUT if deadline passed, ECANCELED if lock is shut
+ * down
+ */
+int rw_lock_timed_write_lock(struct rw_lock *lock, const struct timespec *deadline) {
+    if (!lock->library) {
+        return rw_lock_write_lock(lock);
+    }
+    if (!deadline) {
+        return rw_library_writer_try_enter(lock->library);
+    }
+    return rw_library_writer_timed_enter(lock->library, deadline);
+}
+
+/*!
+ * @brief Shuts lock down, so threads waiting for it can finish: RW_LOCK_FIFO and RW_LOCK_LIBRARIAN - every waiting
+ * thread (and every later locking) gives up with ECANCELED (see rw_library_shutdown). Other backends do nothing -
+ * theirs waiting threads only wait till holders unlock.
+ *
+ * @param lock Lock
+ */
+void rw_lock_shutdown(struct rw_lock *lock) {
+    if (lock->library) {
+        rw_library_shutdown(lock->library);
+    }
+}
+
+/*!
+ * @brief Function gets backend by its name.
+ *
+ * @param name Backend name (native / pthread / phasefair / fifo / librarian)
+ * @return Backend (RW_LOCK_NATIVE / RW_LOCK_PTHREAD / RW_LOCK_PHASE_FAIR / RW_LOCK_FIFO / RW_LOCK_LIBRARIAN) or -1 if
+ * name is unknown
+ */
+int rw_lock_backend(const char *name) {
+    if (strcmp(name, "native") == 0) {
+        return RW_LOCK_NATIVE;
+    } else if (strcmp(name, "pthread") == 0) {
+        return RW_LOCK_PTHREAD;
+    } else if (strcmp(name, "phasefair") == 0) {
+        return RW_LOCK_PHASE_FAIR;
+    } else if (rw_library_policy(name) == RW_LIBRARY_FIFO) {
+        return RW_LOCK_FIFO;
+    } else if (rw_library_policy(name) == RW_LIBRARY_LIBRARIAN) {
+        return RW_LOCK_LIBRARIAN;
+    }
+    return -1;
+}
@@ -0,0 +1,104 @@
+/*!
+ * @file
+ * Readers and Writers - reader-writer lock backends
+ *
+ * Reader-writer locks that can replace program's own librarian scheme, so the same readers and writers workload can be
+ * measured with different locks:
+ * - RW_LOCK_NATIVE - program's own scheme (librarian phases in implementation 1, FIFO queue in implementation 2) - it
+ * is not implemented here,
+ * - RW_LOCK_PTHREAD - pthread_rwlock_t preferring writers,
+ * - RW_LOCK_PHASE_FAIR - phase-fair ticket lock (PF-T by Brandenburg and Anderson): readers and writers phases
+ * alternate, writers are served in FIFO order and every reader waits for at most one writer phase,
+ * - RW_LOCK_FIFO and RW_LOCK_LIBRARIAN - both policies of the program taken out to reader-writer library
+ * (rw_library.h), so the same workload can compare program's scheme with its reusable version.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef RW_LOCK_H
+#define RW_LOCK_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "rw_library.h"
+
+/*!
+ * @brief Program's own scheme (not handled by rw_lock functions).
+ */
+#define RW_LOCK_NATIVE 0
+/*!
+ * @brief pthread_rwlock_t preferring writers.
+ */
+#define RW_LOCK_PTHREAD 1
+/*!
+ * @brief Phase-fair ticket lock.
+ */
+#define RW_LOCK_PHASE_FAIR 2
+/*!
+ * @brief Reader-writer library with FIFO queue policy (implementation 2).
+ */
+#define RW_LOCK_FIFO 3
+/*!
+ * @brief Reader-writer library with librarian policy (implementation 1).
+ */
+#define RW_LOCK_LIBRARIAN 4
+
+/*!
+ * @brief Read window (in nanoseconds) of RW_LOCK_LIBRARIAN backend when program has no read window of its own.
+ */
+#define RW_LOCK_READ_WINDOW 1000000
+
+/*!
+ * @brief Cache line size - phase-fair lock counters changed by readers and by writers are kept in different lines.
+ */
+#define RW_LOCK_CACHE_LINE 64
+
+/*!
+ * @brief Reader-writer lock.
+ */
+struct rw_lock {
+/*!
+ * @brief backend (RW_LOCK_PTHREAD / RW_LOCK_PHASE_FAIR / RW_LOCK_FIFO / RW_LOCK_LIBRARIAN)
+ */
+    int backend;
+/*!
+ * @brief library used by RW_LOCK_FIFO and RW_LOCK_LIBRARIAN backends
+ */
+    struct rw_library *library;
+/*!
+ * @brief lock used by RW_LOCK_PTHREAD backend
+ */
+    pthread_rwlock_t rwlock;
+/*!
+ * @brief phase-fair lock: readers entry ticket (upper bits) and writer presence and phase bits (lower bits)
+ */
+    _Alignas(RW_LOCK_CACHE_LINE) atomic_uint readers_in;
+/*!
+ * @brief phase-fair lock: readers exit ticket
+ */
+    atomic_uint readers_out;
+/*!
+ * @brief phase-fair lock: writers entry ticket
+ */
+    _Alignas(RW_LOCK_CACHE_LINE) atomic_uint writers_in;
+/*!
+ * @brief phase-fair lock: writers exit ticket
+ */
+    atomic_uint writers_out;
+};
+
+void rw_lock_init(struct rw_lock *lock, int backend, int64_t read_window);
+void rw_lock_destroy(struct rw_lock *lock);
+int rw_lock_read_lock(struct rw_lock *lock);
+void rw_lock_read_unlock(struct rw_lock *lock);
+int rw_lock_write_lock(struct rw_lock *lock);
+void rw_lock_write_unlock(struct rw_lock *lock);
+int rw_lock_timed_read_lock(struct rw_lock *lock, const struct timespec *deadline);
+int rw_lock_timed_write_lock(struct rw_lock *lock, const struct timespec *deadline);
+void rw_lock_shutdown(struct rw_lock *lock);
+int rw_lock_backend(const char *name);
+
+#endif
@@ -0,0 +1,82 @@
+/*!
+ * @file
+ * Readers and Writers - sequence lock
+ *
+ * Implementation of sequence lock. Book words are relaxed atomics, so reader's copy racing with writer is not a data
+ * race - ordering comes from fences: writer's release fence after making sequence odd keeps book stores after it, and
+ * reader's acquire fence before second sequence load keeps book loads before it.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include "seqlock.h"
+
+/*!
+ * @brief Initialises lock (sequence 0, empty book).
+ *
+ * @param lock Lock
+ */
+void seqlock_init(struct seqlock *lock) {
+    atomic_init(&lock->sequence, 0);
+    for (int i = 0;i < SEQLOCK_BOOK_WORDS;i++) {
+        atomic_init(&lock->book[i], 0);
+    }
+}
+
+/*!
+ * @brief Function takes sequence snapshot before reading the book.
+ *
+ * @param lock Lock
+ * @return Sequence (odd if writer is writing now - then reader will have to retry)
+ */
+unsigned int seqlock_read_begin(struct seqlock *lock) {
+    return atomic_load_explicit(&lock->sequence, memory_order_acquire);
+}
+
+/*!
+ * @brief Function checks after reading the book if reader has to retry.
+ *
+ * @param lock Lock
+ * @param sequence Snapshot taken by seqlock_read_begin
+ * @return 1 if writer was writing while reader was reading (snapshot was odd or sequence has changed), 0 otherwise
+ */
+int seqlock_read_retry(struct seqlock *lock, unsigned int sequence) {
+    atomic_thread_fence(memory_order_acquire);
+    return (sequence & 1) || atomic_load_explicit(&lock->sequence, memory_order_relaxed) != sequence;
+}
+
+/*!
+ * @brief Function copies the book (copy is correct only if seqlock_read_retry returns 0 afterwards).
+ *
+ * @param lock Lock
+ * @param copy Array of SEQLOCK_BOOK_WORDS words to set
+ */
+void seqlock_read_book(struct seqlock *lock, long long *copy) {
+    for (int i = 0;i < SEQLOCK_BOOK_WORDS;i++) {
+        copy[i] = atomic_load_explicit(&lock->book[i], memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Function makes sequence odd and writes the book. Only one writer can write at a time.
+ *
+ * @param lock Lock
+ * @param value Value written to every word of book
+ */
+void seqlock_write_begin(struct seqlock *lock, long long value) {
+    unsigned int sequence = atomic_load_explicit(&lock->sequence, memory_order_relaxed);
+    atomic_store_explicit(&lock->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (int i = 0;i < SEQLOCK_BOOK_WORDS;i++) {
+        atomic_store_explicit(&lock->book[i], value, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Function makes sequence even again - book is written, so readers that start now do not have to retry.
+ *
+ * @param lock Lock
+ */
+void seqlock_write_end(struct seqlock *lock) {
+    atomic_fetch_add_explicit(&lock->sequence, 1, memory_order_release);
+}
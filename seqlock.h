@@ -0,0 +1,48 @@
+/*!
+ * @file
+ * Readers and Writers - sequence lock
+ *
+ * Sequence lock of library's book for optimistic reads. Writer (let in to library by librarian, so writers never write
+ * at the same time) makes sequence odd, writes the book and makes sequence even again. Reader does not write anything
+ * shared - it takes sequence snapshot, copies the book and checks sequence again. If snapshot was odd or sequence has
+ * changed, writer was writing in the meantime and reader has to retry.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <stdatomic.h>
+
+/*!
+ * @brief Cache line size - sequence and book start at theirs own cache line.
+ */
+#define SEQLOCK_CACHE_LINE 64
+/*!
+ * @brief Number of words of book (sequence and book fill one cache line).
+ */
+#define SEQLOCK_BOOK_WORDS 7
+
+/*!
+ * @brief Sequence lock with its book.
+ */
+struct seqlock {
+/*!
+ * @brief sequence - odd while writer writes the book
+ */
+    _Alignas(SEQLOCK_CACHE_LINE) atomic_uint sequence;
+/*!
+ * @brief book - written by writer (every word set to the same value) and copied by readers
+ */
+    atomic_llong book[SEQLOCK_BOOK_WORDS];
+};
+
+void seqlock_init(struct seqlock *lock);
+unsigned int seqlock_read_begin(struct seqlock *lock);
+int seqlock_read_retry(struct seqlock *lock, unsigned int sequence);
+void seqlock_read_book(struct seqlock *lock, long long *copy);
+void seqlock_write_begin(struct seqlock *lock, long long value);
+void seqlock_write_end(struct seqlock *lock);
+
+#endif
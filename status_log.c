@@ -0,0 +1,179 @@
+/*!
+ * @file
+ * Readers and Writers - asynchronous status log
+ *
+ * Implementation of bounded multiple producers / single consumer ring buffer (every cell has its own sequence number,
+ * so producers only compete for tail index with one compare-and-swap) and logger thread printing events from it.
+ * Producers do not wake logger thread up (they push events with library mutex locked, so they never make a system
+ * call) - logger thread prints all ready events and, when ring buffer is empty, sleeps for STATUS_LOG_POLL_INTERVAL
+ * before it checks it again.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+#include "status_log.h"
+
+/*!
+ * @brief Ring buffer cell.
+ */
+struct status_log_cell {
+/*!
+ * @brief cell sequence number - equal to position when cell is free for producer, position + 1 when event is ready for
+ * consumer
+ */
+    atomic_size_t sequence;
+/*!
+ * @brief reported library state
+ */
+    struct status_event event;
+};
+
+/*!
+ * @brief Ring buffer cells.
+ */
+static struct status_log_cell *cells;
+/*!
+ * @brief Number of cells (power of two).
+ */
+static size_t cells_count;
+/*!
+ * @brief Position that next producer will write to.
+ */
+static atomic_size_t tail;
+/*!
+ * @brief Position that logger thread will read from (used only by logger thread).
+ */
+static size_t head;
+/*!
+ * @brief Number of events dropped because ring buffer was full.
+ */
+static atomic_ulong dropped_count;
+/*!
+ * @brief Flag set when logger thread should print remaining events and finish.
+ */
+static atomic_int stopping;
+/*!
+ * @brief Logger thread.
+ */
+static pthread_t logger_t;
+
+/*!
+ * @brief Prints library state in format:
+ * ReaderQ: readers_in_queue WriterQ: writers_in_queue [ in: R:readers_in_library W:writers_in_library ]
+ *
+ * @param event Library state
+ */
+static void print_event(const struct status_event *event) {
+    printf("ReaderQ: %i\t", event->readers_queue);
+    printf("WriterQ: %i\t", event->writers_queue);
+    printf("[ in: R:%i\t", event->readers_in_library);
+    printf("W:%i ]\n", event->writers_in_library);
+}
+
+/*!
+ * @brief Logger thread. It prints events in order and sleeps for STATUS_LOG_POLL_INTERVAL whenever ring buffer is
+ * empty. When stopping flag is set and ring buffer is empty, thread finishes (all producers are finished before
+ * stopping flag is set, so no event can be pushed later).
+ *
+ * @return NULL
+ */
+static void* logger() {
+    struct timespec interval = {0, STATUS_LOG_POLL_INTERVAL * 1000000L};
+    while (1) {
+        int is_stopping = atomic_load(&stopping);
+        if (head == atomic_load(&tail)) {
+            if (is_stopping) {
+                break;
+            }
+            nanosleep(&interval, NULL);
+            continue;
+        }
+        struct status_log_cell *cell = &cells[head & (cells_count - 1)];
+        while (atomic_load_explicit(&cell->sequence, memory_order_acquire) != head + 1) {
+            sched_yield();
+        }
+        print_event(&cell->event);
+        atomic_store_explicit(&cell->sequence, head + cells_count, memory_order_release);
+        head++;
+    }
+    fflush(stdout);
+    return NULL;
+}
+
+/*!
+ * @brief Allocates ring buffer and starts logger thread.
+ *
+ * @param capacity Minimal number of events that can wait for printing (rounded up to power of two)
+ */
+void status_log_start(unsigned int capacity) {
+    cells_count = 1;
+    while (cells_count < capacity) {
+        cells_count <<= 1;
+    }
+    cells = malloc(cells_count * sizeof(struct status_log_cell));
+    for (size_t i = 0;i < cells_count;i++) {
+        atomic_init(&cells[i].sequence, i);
+    }
+    atomic_init(&tail, 0);
+    head = 0;
+    atomic_init(&dropped_count, 0);
+    atomic_init(&stopping, 0);
+    pthread_create(&logger_t, NULL, logger, NULL);
+}
+
+/*!
+ * @brief Pushes library state to ring buffer. Function never blocks and makes no system call (logger thread finds
+ * the event at its next check) - if ring buffer is full, event is dropped.
+ *
+ * @param readers_queue Number of readers in queue
+ * @param writers_queue Number of writers in queue
+ * @param readers_in_library Number of readers in library
+ * @param writers_in_library Number of writers in library
+ */
+void status_log_push(int readers_queue, int writers_queue, int readers_in_library, int writers_in_library) {
+    size_t position = atomic_load_explicit(&tail, memory_order_relaxed);
+    struct status_log_cell *cell;
+    while (1) {
+        cell = &cells[position & (cells_count - 1)];
+        size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        ptrdiff_t difference = (ptrdiff_t) sequence - (ptrdiff_t) position;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&tail, &position, position + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            atomic_fetch_add_explicit(&dropped_count, 1, memory_order_relaxed);
+            return;
+        } else {
+            position = atomic_load_explicit(&tail, memory_order_relaxed);
+        }
+    }
+    cell->event.readers_queue = readers_queue;
+    cell->event.writers_queue = writers_queue;
+    cell->event.readers_in_library = readers_in_library;
+    cell->event.writers_in_library = writers_in_library;
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+}
+
+/*!
+ * @brief Stops logger thread (after it prints all events already pushed) and frees ring buffer. All producers have to
+ * be finished before.
+ */
+void status_log_stop() {
+    atomic_store(&stopping, 1);
+    pthread_join(logger_t, NULL);
+    free(cells);
+    unsigned long dropped = atomic_load(&dropped_count);
+    if (dropped) {
+        fprintf(stderr, "Status log dropped %lu events (ring buffer was full)\n", dropped);
+    }
+}
@@ -0,0 +1,46 @@
+/*!
+ * @file
+ * Readers and Writers - asynchronous status log
+ *
+ * Library state reports are not printed by threads holding library mutex. Instead every state change is pushed as a
+ * fixed-size event to bounded lock-free ring buffer (multiple producers, single consumer) and printed by background
+ * logger thread. Pushing never blocks - if ring buffer is full, event is dropped and counted.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef STATUS_LOG_H
+#define STATUS_LOG_H
+
+/*!
+ * @brief Time (in milliseconds) that logger thread sleeps when ring buffer is empty before it checks it again.
+ */
+#define STATUS_LOG_POLL_INTERVAL 10
+
+/*!
+ * @brief Library state reported on every change.
+ */
+struct status_event {
+/*!
+ * @brief number of readers in queue
+ */
+    int readers_queue;
+/*!
+ * @brief number of writers in queue
+ */
+    int writers_queue;
+/*!
+ * @brief number of readers in library
+ */
+    int readers_in_library;
+/*!
+ * @brief number of writers in library
+ */
+    int writers_in_library;
+};
+
+void status_log_start(unsigned int capacity);
+void status_log_push(int readers_queue, int writers_queue, int readers_in_library, int writers_in_library);
+void status_log_stop();
+
+#endif
@@ -0,0 +1,484 @@
+/*!
+ * @file
+ * Readers and Writers - task pool
+ *
+ * Implementation of task pool with work stealing. Every worker has its own run queue (deque - ring buffer guarded by
+ * worker's mutex): worker takes tasks from its front, and task submitted by worker (for example readers let in
+ * together by librarian in batch admission mode) is put at the back of this worker's deque, so submitting does not
+ * contend on one queue head. Worker with empty deque steals half of tasks from the back of other worker's deque. Tasks
+ * submitted by other threads are spread over workers in round robin order.
+ *
+ * Tasks submitted with deadline wait in binary min-heap ordered by deadline, guarded by pool mutex. Idle worker moves
+ * expired timers to its deque or sleeps on pool conditional variable till nearest deadline. Submitting thread wakes up
+ * sleeping worker only if there is one (idle_workers counter), so busy pool does not touch pool mutex at all.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "task_pool.h"
+#include "topology.h"
+
+/*!
+ * @brief Number of nanoseconds in one second.
+ */
+#define NANOSECONDS_IN_SECOND 1000000000LL
+
+/*!
+ * @brief Cache line size - every worker's state starts at its own cache line.
+ */
+#define TASK_POOL_CACHE_LINE 64
+
+/*!
+ * @brief Worker's state. Deque and mutex are used by owner and by thieves, statistics are written only by owner.
+ */
+struct worker {
+/*!
+ * @brief mutex guarding deque
+ */
+    _Alignas(TASK_POOL_CACHE_LINE) pthread_mutex_t mutex;
+/*!
+ * @brief deque of tasks (ring buffer with tasks_capacity positions)
+ */
+    struct task **tasks;
+/*!
+ * @brief position of first task in deque
+ */
+    int head;
+/*!
+ * @brief number of tasks in deque (changed under mutex, read without it to find tasks to steal)
+ */
+    atomic_int size;
+/*!
+ * @brief worker's position in *workers
+ */
+    int index;
+/*!
+ * @brief worker thread
+ */
+    pthread_t thread;
+/*!
+ * @brief number of tasks run by worker
+ */
+    long long tasks_run;
+/*!
+ * @brief number of tasks stolen by worker from other workers
+ */
+    long long tasks_stolen;
+/*!
+ * @brief time (in nanoseconds) that worker spent idle (with no task to run)
+ */
+    int64_t idle_time;
+/*!
+ * @brief number of tasks taken by worker from its own deque
+ */
+    long long tasks_popped;
+/*!
+ * @brief sum of deque depths sampled every time worker takes task from its own deque
+ */
+    long long depth_sum;
+/*!
+ * @brief maximum sampled deque depth
+ */
+    int max_depth;
+};
+
+/*!
+ * @brief Mutex guarding timers heap and sleeping of idle workers.
+ */
+static pthread_mutex_t pool_mutex;
+/*!
+ * @brief Conditional variable that idle workers wait on (with monotonic clock deadline if there are timers).
+ */
+static pthread_cond_t pool_cond;
+/*!
+ * @brief Timers heap - binary min-heap of tasks ordered by deadline.
+ */
+static struct task **timers;
+/*!
+ * @brief Number of tasks in timers heap.
+ */
+static int timers_size;
+/*!
+ * @brief Number of workers that are about to sleep or sleep on pool_cond.
+ */
+static atomic_int idle_workers;
+/*!
+ * @brief Flag set when workers should finish.
+ */
+static atomic_int stopping;
+/*!
+ * @brief Workers states.
+ */
+static struct worker *workers;
+/*!
+ * @brief Number of worker threads.
+ */
+static int workers_count;
+/*!
+ * @brief Capacity of every deque (maximum number of tasks).
+ */
+static int tasks_capacity;
+/*!
+ * @brief Counter used to spread tasks submitted by threads that are not workers.
+ */
+static atomic_uint next_worker;
+/*!
+ * @brief Worker run by current thread, NULL if current thread is not a worker.
+ */
+static _Thread_local struct worker *current_worker;
+
+/*!
+ * @brief Function gets timestamp (in nanoseconds) from monotonic clock.
+ *
+ * @return Timestamp in nanoseconds
+ */
+static int64_t get_timestamp() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t) now.tv_sec * NANOSECONDS_IN_SECOND + now.tv_nsec;
+}
+
+/*!
+ * @brief Puts task at the back of worker's deque.
+ *
+ * @param worker Worker
+ * @param task Task
+ */
+static void push_task(struct worker *worker, struct task *task) {
+    pthread_mutex_lock(&worker->mutex);
+    int size = atomic_load_explicit(&worker->size, memory_order_relaxed);
+    worker->tasks[(worker->head + size) % tasks_capacity] = task;
+    atomic_store(&worker->size, size + 1);
+    pthread_mutex_unlock(&worker->mutex);
+}
+
+/*!
+ * @brief Takes task from the front of worker's own deque and samples deque depth.
+ *
+ * @param worker Worker (of current thread)
+ * @return Task or NULL if deque is empty
+ */
+static struct task* pop_task(struct worker *worker) {
+    if (!atomic_load_explicit(&worker->size, memory_order_relaxed)) {
+        return NULL;
+    }
+    struct task *task = NULL;
+    pthread_mutex_lock(&worker->mutex);
+    int size = atomic_load_explicit(&worker->size, memory_order_relaxed);
+    if (size) {
+        task = worker->tasks[worker->head];
+        worker->head = (worker->head + 1) % tasks_capacity;
+        atomic_store_explicit(&worker->size, size - 1, memory_order_relaxed);
+        worker->tasks_popped++;
+        worker->depth_sum += size;
+        if (size > worker->max_depth) {
+            worker->max_depth = size;
+        }
+    }
+    pthread_mutex_unlock(&worker->mutex);
+    return task;
+}
+
+/*!
+ * @brief Steals half of tasks (at least one) from the back of first other worker's deque that is not empty. One task
+ * is returned to be run at once, the rest is put to thief's deque.
+ *
+ * @param thief Worker (of current thread)
+ * @return Task or NULL if there is nothing to steal
+ */
+static struct task* steal_tasks(struct worker *thief) {
+    for (int i = 1;i < workers_count;i++) {
+        struct worker *victim = &workers[(thief->index + i) % workers_count];
+        if (!atomic_load(&victim->size)) {
+            continue;
+        }
+        struct task *stolen = NULL;
+        int count = 0;
+        pthread_mutex_lock(&victim->mutex);
+        int size = atomic_load_explicit(&victim->size, memory_order_relaxed);
+        count = (size + 1) / 2;
+        for (int j = 0;j < count;j++) {
+            struct task *task = victim->tasks[(victim->head + size - 1 - j) % tasks_capacity];
+            task->next = stolen;
+            stolen = task;
+        }
+        atomic_store_explicit(&victim->size, size - count, memory_order_relaxed);
+        pthread_mutex_unlock(&victim->mutex);
+        if (!stolen) {
+            continue;
+        }
+        thief->tasks_stolen += count;
+        struct task *task = stolen;
+        stolen = stolen->next;
+        while (stolen) {
+            struct task *next = stolen->next;
+            push_task(thief, stolen);
+            stolen = next;
+        }
+        return task;
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Function checks is there any task in any deque.
+ *
+ * @return 1 if some deque is not empty, 0 otherwise
+ */
+static int has_tasks() {
+    for (int i = 0;i < workers_count;i++) {
+        if (atomic_load(&workers[i].size)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * @brief Puts task to timers heap (sifting it up to its position). Pool mutex has to be locked.
+ *
+ * @param task Task with deadline set
+ */
+static void push_timer(struct task *task) {
+    int position = timers_size++;
+    while (position > 0) {
+        int parent = (position - 1) / 2;
+        if (timers[parent]->deadline <= task->deadline) {
+            break;
+        }
+        timers[position] = timers[parent];
+        position = parent;
+    }
+    timers[position] = task;
+}
+
+/*!
+ * @brief Takes task with nearest deadline from timers heap (sifting last task down). Pool mutex has to be locked and
+ * heap can not be empty.
+ *
+ * @return Task
+ */
+static struct task* pop_timer() {
+    struct task *nearest = timers[0];
+    struct task *last = timers[--timers_size];
+    int position = 0;
+    while (1) {
+        int child = 2 * position + 1;
+        if (child >= timers_size) {
+            break;
+        }
+        if (child + 1 < timers_size && timers[child + 1]->deadline < timers[child]->deadline) {
+            child++;
+        }
+        if (last->deadline <= timers[child]->deadline) {
+            break;
+        }
+        timers[position] = timers[child];
+        position = child;
+    }
+    timers[position] = last;
+    return nearest;
+}
+
+/*!
+ * @brief Idle worker moves expired timers to its deque (waking up other idle workers, so they can steal them). If
+ * there were no expired timers and no task was submitted in the meantime, it sleeps till nearest deadline (or till
+ * task is submitted). Worker is counted in idle_workers before it checks deques, so task submitted concurrently is
+ * either seen by worker or submitting thread sees idle worker and wakes it up.
+ *
+ * @param worker Worker (of current thread)
+ */
+static void wait_for_task(struct worker *worker) {
+    int64_t idle_from = get_timestamp();
+    pthread_mutex_lock(&pool_mutex);
+    atomic_fetch_add(&idle_workers, 1);
+    int expired = 0;
+    int64_t now = get_timestamp();
+    while (timers_size && timers[0]->deadline <= now) {
+        push_task(worker, pop_timer());
+        expired++;
+    }
+    if (expired > 1) {
+        pthread_cond_broadcast(&pool_cond);
+    } else if (!expired && !atomic_load(&stopping) && !has_tasks()) {
+        if (timers_size) {
+            struct timespec deadline;
+            deadline.tv_sec = timers[0]->deadline / NANOSECONDS_IN_SECOND;
+            deadline.tv_nsec = timers[0]->deadline % NANOSECONDS_IN_SECOND;
+            pthread_cond_timedwait(&pool_cond, &pool_mutex, &deadline);
+        } else {
+            pthread_cond_wait(&pool_cond, &pool_mutex);
+        }
+    }
+    atomic_fetch_sub(&idle_workers, 1);
+    pthread_mutex_unlock(&pool_mutex);
+    worker->idle_time += get_timestamp() - idle_from;
+}
+
+/*!
+ * @brief Worker thread. It runs tasks till pool is stopped - first from its own deque, then stolen from other workers.
+ * When there is nothing to run, it waits (see wait_for_task).
+ *
+ * @param arg Worker
+ * @return NULL
+ */
+static void* worker_thread(void *arg) {
+    struct worker *worker = arg;
+    current_worker = worker;
+    while (!atomic_load(&stopping)) {
+        struct task *task = pop_task(worker);
+        if (!task) {
+            task = steal_tasks(worker);
+        }
+        if (!task) {
+            wait_for_task(worker);
+            continue;
+        }
+        worker->tasks_run++;
+        task->run(task);
+    }
+    return NULL;
+}
+
+/*!
+ * @brief Starts worker threads.
+ *
+ * @param count Number of worker threads
+ * @param tasks_count Maximum number of tasks (size of timers heap and of every deque)
+ * @param pin_mode Pin mode of workers (TOPOLOGY_PIN_NONE / TOPOLOGY_PIN_CPU / TOPOLOGY_PIN_NODE, see topology_pin)
+ */
+void task_pool_start(int count, int tasks_count, int pin_mode) {
+    workers_count = count;
+    tasks_capacity = tasks_count > 0 ? tasks_count : 1;
+    workers = aligned_alloc(TASK_POOL_CACHE_LINE, workers_count * sizeof(struct worker));
+    timers = malloc(tasks_capacity * sizeof(struct task *));
+    timers_size = 0;
+    atomic_init(&idle_workers, 0);
+    atomic_init(&stopping, 0);
+    atomic_init(&next_worker, 0);
+    pthread_mutex_init(&pool_mutex, NULL);
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    int i;
+    for (i = 0;i < workers_count;i++) {
+        struct worker *worker = &workers[i];
+        pthread_mutex_init(&worker->mutex, NULL);
+        worker->tasks = malloc(tasks_capacity * sizeof(struct task *));
+        worker->head = 0;
+        atomic_init(&worker->size, 0);
+        worker->index = i;
+        worker->tasks_run = 0;
+        worker->tasks_stolen = 0;
+        worker->tasks_popped = 0;
+        worker->idle_time = 0;
+        worker->depth_sum = 0;
+        worker->max_depth = 0;
+    }
+    for (i = 0;i < workers_count;i++) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        topology_pin(&attr, pin_mode, i, workers_count);
+        pthread_create(&workers[i].thread, &attr, worker_thread, &workers[i]);
+        pthread_attr_destroy(&attr);
+    }
+}
+
+/*!
+ * @brief Submits task to run queue - to deque of current worker (if it is called by task) or of next worker in round
+ * robin order - and wakes up idle worker if there is one. Task can not be in run queue or timers heap already.
+ *
+ * @param task Task
+ */
+void task_pool_submit(struct task *task) {
+    struct worker *worker = current_worker;
+    if (!worker) {
+        worker = &workers[atomic_fetch_add_explicit(&next_worker, 1, memory_order_relaxed) % workers_count];
+    }
+    push_task(worker, task);
+    if (atomic_load(&idle_workers)) {
+        pthread_mutex_lock(&pool_mutex);
+        pthread_cond_signal(&pool_cond);
+        pthread_mutex_unlock(&pool_mutex);
+    }
+}
+
+/*!
+ * @brief Submits task that will be run when deadline passes. Task can not be in run queue or timers heap already.
+ *
+ * @param task Task
+ * @param deadline Monotonic clock timestamp in nanoseconds
+ */
+void task_pool_submit_at(struct task *task, int64_t deadline) {
+    pthread_mutex_lock(&pool_mutex);
+    task->deadline = deadline;
+    push_timer(task);
+    if (timers[0] == task) {
+        pthread_cond_signal(&pool_cond);
+    }
+    pthread_mutex_unlock(&pool_mutex);
+}
+
+/*!
+ * @brief Stops worker threads (each finishes step of task it is running) and joins them. Tasks left in deques and
+ * timers heap are not run any more. Workers statistics are kept till task_pool_destroy.
+ */
+void task_pool_stop() {
+    pthread_mutex_lock(&pool_mutex);
+    atomic_store(&stopping, 1);
+    pthread_cond_broadcast(&pool_cond);
+    pthread_mutex_unlock(&pool_mutex);
+    for (int i = 0;i < workers_count;i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+}
+
+/*!
+ * @brief Prints statistics of every worker: number of tasks run and stolen, idle time and average and maximum depth
+ * of its deque. Pool has to be stopped.
+ */
+void task_pool_print_stats() {
+    printf("%-24s %10s %10s %12s %12s %12s\n", "Task pool", "tasks", "stolen", "idle (s)", "avg depth", "max depth");
+    for (int i = 0;i < workers_count;i++) {
+        struct worker *worker = &workers[i];
+        char name[32];
+        snprintf(name, sizeof(name), "Worker %i", i);
+        printf("%-24s %10lld %10lld %12.3f %12.2f %12i\n", name, worker->tasks_run, worker->tasks_stolen,
+               worker->idle_time / (double) NANOSECONDS_IN_SECOND,
+               worker->tasks_popped ? worker->depth_sum / (double) worker->tasks_popped : 0.0, worker->max_depth);
+    }
+    printf("\n");
+}
+
+/*!
+ * @brief Frees pool memory. Pool has to be stopped.
+ */
+void task_pool_destroy() {
+    for (int i = 0;i < workers_count;i++) {
+        pthread_mutex_destroy(&workers[i].mutex);
+        free(workers[i].tasks);
+    }
+    pthread_mutex_destroy(&pool_mutex);
+    pthread_cond_destroy(&pool_cond);
+    free(workers);
+    free(timers);
+}
+
+/*!
+ * @brief Function gets default number of worker threads - number of online processors.
+ *
+ * @return Number of worker threads (at least 1)
+ */
+int task_pool_default_workers() {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int) count : 1;
+}
@@ -0,0 +1,45 @@
+/*!
+ * @file
+ * Readers and Writers - task pool
+ *
+ * Fixed pool of worker threads running lightweight tasks, so readers and writers do not need one thread each. Task is
+ * a state machine - every run is one step that must not block. Waiting task (parked) simply returns without being
+ * submitted again, and whoever lets it in submits it back to run queue. Task can also be submitted with deadline (it
+ * is kept in timers heap till deadline passes), which replaces sleeping. Every worker has its own run queue and idle
+ * workers steal tasks from others, so tasks submitted together spread over all workers.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <stdint.h>
+
+/*!
+ * @brief Task. It is usually first member of bigger structure with task state.
+ */
+struct task {
+/*!
+ * @brief step function - it is called by worker thread every time task is taken from run queue
+ */
+    void (*run)(struct task *task);
+/*!
+ * @brief next task in list of tasks stolen together
+ */
+    struct task *next;
+/*!
+ * @brief deadline (monotonic clock timestamp in nanoseconds) of task waiting in timers heap
+ */
+    int64_t deadline;
+};
+
+void task_pool_start(int count, int tasks_count, int pin_mode);
+void task_pool_submit(struct task *task);
+void task_pool_submit_at(struct task *task, int64_t deadline);
+void task_pool_stop();
+void task_pool_print_stats();
+void task_pool_destroy();
+int task_pool_default_workers();
+
+#endif
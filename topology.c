@@ -0,0 +1,236 @@
+/*!
+ * @file
+ * Readers and Writers - processor topology
+ *
+ * Implementation of processor topology. Nodes are read from /sys/devices/system/node/online and processors of every
+ * node from its cpulist (only processors that program is allowed to run on are used). Node-local memory is requested
+ * with mbind system call (preferred policy, so allocation does not fail when node runs out of memory) - it is called
+ * directly, so program does not need libnuma.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/syscall.h>
+
+#include "topology.h"
+
+/*!
+ * @brief Maximum length of sysfs list (for example "0-63,128-191").
+ */
+#define TOPOLOGY_LIST_LENGTH 4096
+/*!
+ * @brief mbind policy: allocate memory on given node if it is possible.
+ */
+#define TOPOLOGY_MPOL_PREFERRED 1
+
+/*!
+ * @brief Number of nodes.
+ */
+static int nodes_count;
+/*!
+ * @brief Node numbers (as in sysfs).
+ */
+static int *node_ids;
+/*!
+ * @brief Processors of every node.
+ */
+static cpu_set_t *node_cpus;
+
+/*!
+ * @brief Function reads list in sysfs format ("0-3,8,10-11") and adds its numbers to set.
+ *
+ * @param path Path of sysfs file
+ * @param set Set
+ * @return 1 if file was read, 0 otherwise
+ */
+static int read_list(const char *path, cpu_set_t *set) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+    char list[TOPOLOGY_LIST_LENGTH];
+    int is_read = fgets(list, sizeof(list), file) != NULL;
+    fclose(file);
+    if (!is_read) {
+        return 0;
+    }
+    CPU_ZERO(set);
+    char *position = list;
+    while (*position >= '0' && *position <= '9') {
+        int first = (int) strtol(position, &position, 10);
+        int last = first;
+        if (*position == '-') {
+            last = (int) strtol(position + 1, &position, 10);
+        }
+        for (int i = first;i <= last && i < CPU_SETSIZE;i++) {
+            CPU_SET(i, set);
+        }
+        if (*position == ',') {
+            position++;
+        }
+    }
+    return 1;
+}
+
+/*!
+ * @brief Reads nodes and theirs processors. If sysfs can not be read, all allowed processors are one node.
+ */
+void topology_init() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    cpu_set_t online;
+    nodes_count = 0;
+    if (read_list("/sys/devices/system/node/online", &online)) {
+        node_ids = malloc(CPU_COUNT(&online) * sizeof(int));
+        node_cpus = malloc(CPU_COUNT(&online) * sizeof(cpu_set_t));
+        for (int node = 0;node < CPU_SETSIZE;node++) {
+            if (!CPU_ISSET(node, &online)) {
+                continue;
+            }
+            char path[64];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%i/cpulist", node);
+            cpu_set_t *cpus = &node_cpus[nodes_count];
+            if (read_list(path, cpus)) {
+                CPU_AND(cpus, cpus, &allowed);
+                if (CPU_COUNT(cpus)) {
+                    node_ids[nodes_count++] = node;
+                }
+            }
+        }
+    }
+    if (!nodes_count) {
+        free(node_ids);
+        free(node_cpus);
+        node_ids = malloc(sizeof(int));
+        node_cpus = malloc(sizeof(cpu_set_t));
+        node_ids[0] = 0;
+        node_cpus[0] = allowed;
+        nodes_count = 1;
+    }
+}
+
+/*!
+ * @brief Frees memory allocated for topology.
+ */
+void topology_destroy() {
+    free(node_ids);
+    free(node_cpus);
+}
+
+/*!
+ * @brief Function returns number of nodes.
+ *
+ * @return Number of nodes (at least 1)
+ */
+int topology_nodes_count() {
+    return nodes_count;
+}
+
+/*!
+ * @brief Function gets node of thread.
+ *
+ * @param index Position of thread among threads of its kind
+ * @param count Number of threads of this kind
+ * @return Node (position in topology, from 0 to topology_nodes_count() - 1)
+ */
+int topology_node_of(int index, int count) {
+    return (int) ((long long) index * nodes_count / count);
+}
+
+/*!
+ * @brief Function gets position of first thread of node's block.
+ *
+ * @param node Node (position in topology)
+ * @param count Number of threads of this kind
+ * @return Position of first thread of node (count if node is topology_nodes_count())
+ */
+int topology_first_of(int node, int count) {
+    return (int) (((long long) node * count + nodes_count - 1) / nodes_count);
+}
+
+/*!
+ * @brief Function sets affinity of thread attributes - to all processors of thread's node or to one of them.
+ *
+ * @param attr Attributes of thread that is going to be created
+ * @param mode Pin mode (TOPOLOGY_PIN_NONE / TOPOLOGY_PIN_CPU / TOPOLOGY_PIN_NODE)
+ * @param index Position of thread among threads of its kind
+ * @param count Number of threads of this kind
+ */
+void topology_pin(pthread_attr_t *attr, int mode, int index, int count) {
+    if (mode == TOPOLOGY_PIN_NONE) {
+        return;
+    }
+    int node = topology_node_of(index, count);
+    if (mode == TOPOLOGY_PIN_NODE) {
+        pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &node_cpus[node]);
+        return;
+    }
+    int cpu_number = (index - topology_first_of(node, count)) % CPU_COUNT(&node_cpus[node]);
+    for (int cpu = 0;cpu < CPU_SETSIZE;cpu++) {
+        if (CPU_ISSET(cpu, &node_cpus[node]) && cpu_number-- == 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &set);
+            return;
+        }
+    }
+}
+
+/*!
+ * @brief Allocates page aligned array of per-thread elements. If there is more than one node, pages of block of
+ * elements of every node (see topology_node_of) are placed in this node's memory (pages shared by two blocks stay
+ * with the first node that touches them).
+ *
+ * @param count Number of elements
+ * @param size Size of one element
+ * @return Array (it has to be freed with free)
+ */
+void* topology_alloc(int count, size_t size) {
+    size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+    size_t length = ((count * size + page_size - 1) / page_size) * page_size;
+    char *array = aligned_alloc(page_size, length ? length : page_size);
+    if (nodes_count < 2 || !count) {
+        return array;
+    }
+    for (int node = 0;node < nodes_count;node++) {
+        if (node_ids[node] >= (int) (8 * sizeof(unsigned long))) {
+            continue;
+        }
+        size_t first = topology_first_of(node, count) * size;
+        size_t last = topology_first_of(node + 1, count) * size;
+        size_t start = ((first + page_size - 1) / page_size) * page_size;
+        size_t end = (last / page_size) * page_size;
+        if (start < end) {
+            unsigned long node_mask = 1UL << node_ids[node];
+            syscall(SYS_mbind, array + start, end - start, TOPOLOGY_MPOL_PREFERRED, &node_mask,
+                    8 * sizeof(unsigned long), 0);
+        }
+    }
+    return array;
+}
+
+/*!
+ * @brief Function gets pin mode by its name.
+ *
+ * @param name Pin mode name (none / cpu / node)
+ * @return Pin mode (TOPOLOGY_PIN_NONE / TOPOLOGY_PIN_CPU / TOPOLOGY_PIN_NODE) or -1 if name is unknown
+ */
+int topology_pin_mode(const char *name) {
+    if (strcmp(name, "none") == 0) {
+        return TOPOLOGY_PIN_NONE;
+    } else if (strcmp(name, "cpu") == 0) {
+        return TOPOLOGY_PIN_CPU;
+    } else if (strcmp(name, "node") == 0) {
+        return TOPOLOGY_PIN_NODE;
+    }
+    return -1;
+}
@@ -0,0 +1,41 @@
+/*!
+ * @file
+ * Readers and Writers - processor topology
+ *
+ * NUMA nodes and theirs processors read from sysfs (if sysfs is not available, all processors program can run on are
+ * one node). Threads of one kind are spread over nodes in contiguous blocks - thread with position index of count
+ * threads belongs to node index * nodes / count - so both thread placement and node-local memory of per-thread arrays
+ * use the same assignment.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+/*!
+ * @brief Threads are not pinned.
+ */
+#define TOPOLOGY_PIN_NONE 0
+/*!
+ * @brief Every thread is pinned to one processor of its node (processors of node are used in round robin order).
+ */
+#define TOPOLOGY_PIN_CPU 1
+/*!
+ * @brief Every thread is pinned to all processors of its node.
+ */
+#define TOPOLOGY_PIN_NODE 2
+
+void topology_init();
+void topology_destroy();
+int topology_nodes_count();
+int topology_node_of(int index, int count);
+int topology_first_of(int node, int count);
+void topology_pin(pthread_attr_t *attr, int mode, int index, int count);
+void* topology_alloc(int count, size_t size);
+int topology_pin_mode(const char *name);
+
+#endif
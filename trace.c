@@ -0,0 +1,250 @@
+/*!
+ * @file
+ * Readers and Writers - workload trace
+ *
+ * Implementation of workload trace. File is memory-mapped and read once, sequentially - records are parsed straight
+ * from mapped pages (without copying file to buffer) and linked into chain of every client, so every reader or writer
+ * walks only its own records during replay.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "trace.h"
+
+/*!
+ * @brief Highest number accepted in trace file - numbers are checked before every digit is added, so reading them never
+ * overflows, and timestamp not longer than INT64_MAX / 4 nanoseconds (over 73 years) can be added to start time of
+ * replay.
+ */
+#define TRACE_MAX_NUMBER (INT64_MAX / 4)
+
+/*!
+ * @brief Function skips spaces and tabs.
+ *
+ * @param position Current position in file
+ * @param end End of file
+ * @return First position that is not space or tab
+ */
+static const char* skip_blanks(const char *position, const char *end) {
+    while (position < end && (*position == ' ' || *position == '\t')) {
+        position++;
+    }
+    return position;
+}
+
+/*!
+ * @brief Function reads non-negative decimal number not greater than TRACE_MAX_NUMBER.
+ *
+ * @param position Current position in file (it is moved after number)
+ * @param end End of file
+ * @param number Number to set
+ * @return 1 if number was read, 0 if there is no digit at position or number is greater than TRACE_MAX_NUMBER
+ */
+static int read_number(const char **position, const char *end, int64_t *number) {
+    const char *digit = *position;
+    *number = 0;
+    while (digit < end && *digit >= '0' && *digit <= '9') {
+        int value = *digit++ - '0';
+        if (*number > (TRACE_MAX_NUMBER - value) / 10) {
+            return 0;
+        }
+        *number = *number * 10 + value;
+    }
+    if (digit == *position) {
+        return 0;
+    }
+    *position = digit;
+    return 1;
+}
+
+/*!
+ * @brief Function reads one record (timestamp role client_id hold) that starts at given position.
+ *
+ * @param position Current position in file (it is moved to end of line)
+ * @param end End of file
+ * @param record Record to set (without next)
+ * @param role Role to set (TRACE_READER / TRACE_WRITER)
+ * @param client_id Client id to set
+ * @return 1 if record is correct, 0 otherwise
+ */
+static int read_record(const char **position, const char *end, struct trace_record *record, int *role,
+                       int64_t *client_id) {
+    if (!read_number(position, end, &record->timestamp)) {
+        return 0;
+    }
+    *position = skip_blanks(*position, end);
+    if (*position == end || (**position != 'R' && **position != 'r' && **position != 'W' && **position != 'w')) {
+        return 0;
+    }
+    *role = **position == 'R' || **position == 'r' ? TRACE_READER : TRACE_WRITER;
+    while (*position < end && **position != ' ' && **position != '\t' && **position != '\n') {
+        (*position)++;
+    }
+    *position = skip_blanks(*position, end);
+    if (!read_number(position, end, client_id)) {
+        return 0;
+    }
+    *position = skip_blanks(*position, end);
+    if (!read_number(position, end, &record->hold)) {
+        return 0;
+    }
+    *position = skip_blanks(*position, end);
+    if (*position < end && **position == '\r') {
+        (*position)++;
+    }
+    return *position == end || **position == '\n';
+}
+
+/*!
+ * @brief Loads trace from file. Every record has to be correct and its client id has to be lower than number of
+ * readers or writers.
+ *
+ * @param trace Trace
+ * @param path Path of trace file
+ * @param readers_count Number of readers
+ * @param writers_count Number of writers
+ * @return 0 if trace was loaded, number of first wrong line otherwise (-1 if file can not be read)
+ */
+int trace_load(struct trace *trace, const char *path, int readers_count, int writers_count) {
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return -1;
+    }
+    struct stat file_stat;
+    if (fstat(file, &file_stat) < 0) {
+        close(file);
+        return -1;
+    }
+    size_t length = (size_t) file_stat.st_size;
+    const char *data = length ? mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0) : NULL;
+    close(file);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    madvise((void *) data, length, MADV_SEQUENTIAL);
+    const char *end = data + length;
+
+    int lines_count = 1;
+    for (const char *position = data;position < end;position++) {
+        lines_count += *position == '\n';
+    }
+    trace->records = malloc(lines_count * sizeof(struct trace_record));
+    trace->records_count = 0;
+    trace->readers_count = readers_count;
+    trace->first = malloc((readers_count + writers_count) * sizeof(int));
+    int *last = malloc((readers_count + writers_count) * sizeof(int));
+    int i;
+    for (i = 0;i < readers_count + writers_count;i++) {
+        trace->first[i] = -1;
+        last[i] = -1;
+    }
+    atomic_init(&trace->clients_left, readers_count + writers_count);
+    atomic_init(&trace->replayed_count, 0);
+    atomic_init(&trace->late_count, 0);
+
+    int error_line = 0;
+    int line = 0;
+    const char *position = data;
+    while (position < end && !error_line) {
+        line++;
+        position = skip_blanks(position, end);
+        if (position < end && *position != '\n' && *position != '\r' && *position != '#') {
+            struct trace_record *record = &trace->records[trace->records_count];
+            int role;
+            int64_t client_id;
+            if (!read_record(&position, end, record, &role, &client_id) ||
+                client_id >= (role == TRACE_READER ? readers_count : writers_count)) {
+                error_line = line;
+                break;
+            }
+            int client = role == TRACE_READER ? (int) client_id : readers_count + (int) client_id;
+            record->next = -1;
+            if (last[client] < 0) {
+                trace->first[client] = trace->records_count;
+            } else {
+                trace->records[last[client]].next = trace->records_count;
+            }
+            last[client] = trace->records_count++;
+        }
+        while (position < end && *position++ != '\n') {
+            continue;
+        }
+    }
+    free(last);
+    if (length) {
+        munmap((void *) data, length);
+    }
+    if (error_line) {
+        trace_destroy(trace);
+    }
+    return error_line;
+}
+
+/*!
+ * @brief Frees memory allocated for trace.
+ *
+ * @param trace Trace
+ */
+void trace_destroy(struct trace *trace) {
+    free(trace->records);
+    free(trace->first);
+    trace->records = NULL;
+    trace->first = NULL;
+}
+
+/*!
+ * @brief Function gets first record of client.
+ *
+ * @param trace Trace
+ * @param role Role of client (TRACE_READER / TRACE_WRITER)
+ * @param client_id Reader or writer id
+ * @return Position of first record in trace->records, -1 if client has no records
+ */
+int trace_first(struct trace *trace, int role, int client_id) {
+    return trace->first[role == TRACE_READER ? client_id : trace->readers_count + client_id];
+}
+
+/*!
+ * @brief Function marks that client has replayed all its records.
+ *
+ * @param trace Trace
+ * @return 1 if it was the last client with records to replay, 0 otherwise
+ */
+int trace_finish(struct trace *trace) {
+    return atomic_fetch_sub(&trace->clients_left, 1) == 1;
+}
+
+/*!
+ * @brief Function counts replayed record (atomically, so it can be called without mutex).
+ *
+ * @param trace Trace
+ * @param is_late 1 if record started after its arrival time, 0 otherwise
+ */
+void trace_count(struct trace *trace, int is_late) {
+    atomic_fetch_add_explicit(&trace->replayed_count, 1, memory_order_relaxed);
+    if (is_late) {
+        atomic_fetch_add_explicit(&trace->late_count, 1, memory_order_relaxed);
+    }
+}
+
+/*!
+ * @brief Prints numbers of records in trace, replayed records and records that started late.
+ *
+ * @param trace Trace
+ */
+void trace_print_stats(struct trace *trace) {
+    long long replayed = atomic_load(&trace->replayed_count);
+    long long late = atomic_load(&trace->late_count);
+    printf("%-24s %10s %12s\n", "Trace records", "count", "percent");
+    printf("%-24s %10i %12.2f\n", "In trace", trace->records_count, 100.0);
+    printf("%-24s %10lld %12.2f\n", "Replayed", replayed,
+           trace->records_count ? 100.0 * replayed / trace->records_count : 0.0);
+    printf("%-24s %10lld %12.2f\n\n", "Late", late, replayed ? 100.0 * late / replayed : 0.0);
+}
@@ -0,0 +1,89 @@
+/*!
+ * @file
+ * Readers and Writers - workload trace
+ *
+ * Trace of library accesses replayed instead of random times. Trace file is a text file with one record per line:
+ * timestamp role client_id hold - timestamp (nanoseconds from start of program) when client arrives at library, role
+ * (R - reader, W - writer), id of reader or writer and time (in nanoseconds) it holds library. Empty lines and lines
+ * starting with # are skipped. Arrivals are open-loop - client that is still in library (or in queue) at its next
+ * arrival is late and its wait in queue is counted from the timestamp of record, not from the moment it got to queue.
+ * Records of one client are replayed in order of file.
+ *
+ * @author Mateusz Wawreszuk
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/*!
+ * @brief Role of reader.
+ */
+#define TRACE_READER 0
+/*!
+ * @brief Role of writer.
+ */
+#define TRACE_WRITER 1
+
+/*!
+ * @brief One access of client to library.
+ */
+struct trace_record {
+/*!
+ * @brief arrival time in nanoseconds from start of replay
+ */
+    int64_t timestamp;
+/*!
+ * @brief time in nanoseconds spent in library
+ */
+    int64_t hold;
+/*!
+ * @brief position of next record of the same client, -1 if it's the last one
+ */
+    int next;
+};
+
+/*!
+ * @brief Loaded trace.
+ */
+struct trace {
+/*!
+ * @brief all records in order of file
+ */
+    struct trace_record *records;
+/*!
+ * @brief number of records
+ */
+    int records_count;
+/*!
+ * @brief position of first record of every client (-1 if client has no records) - readers first, writers follow them
+ */
+    int *first;
+/*!
+ * @brief number of readers
+ */
+    int readers_count;
+/*!
+ * @brief number of clients that have not finished theirs records yet
+ */
+    atomic_int clients_left;
+/*!
+ * @brief number of replayed records
+ */
+    atomic_llong replayed_count;
+/*!
+ * @brief number of replayed records that started after theirs arrival time (client was busy or woke up late)
+ */
+    atomic_llong late_count;
+};
+
+int trace_load(struct trace *trace, const char *path, int readers_count, int writers_count);
+void trace_destroy(struct trace *trace);
+int trace_first(struct trace *trace, int role, int client_id);
+int trace_finish(struct trace *trace);
+void trace_count(struct trace *trace, int is_late);
+void trace_print_stats(struct trace *trace);
+
+#endif